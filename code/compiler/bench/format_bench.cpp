@@ -0,0 +1,273 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Host benchmark of the firmware's slot dump formatting
+ * @details Times the two ways the firmware has built a "^!,p" line
+ * of a slot dump:
+ * - Old: strcpy/strcat into tx_buf, with itos and get_num_length,
+ *   then serial_writeln_s. As it was before the streaming replies.
+ * - New: line_begin/line_u/line_s/line_i/line_end with utos, as in
+ *   src/sys/io/serial_control.c and src/common/util.c now.
+ *
+ * Both are copied here, because the firmware sources need the AVR
+ * headers. Each one writes through the same serial_write_c, which
+ * isn't inlined, into a ring like the TX one. The best of 7 runs of
+ * 2,000,000 lines is kept, and both lines are printed at the end to
+ * show they are the same.
+ *
+ * Run with "make bench" from code/compiler. It is built with -Os as
+ * the firmware is, BENCH_FLAGS can be used to change that. On the
+ * device, "^?,h" reads the format latency histogram instead.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#define SER_BUFS_SIZE 64
+#define NUM_PINS 8
+#define NOINLINE __attribute__((noinline))
+
+typedef struct {
+    char name[16];
+    uint8_t mode;
+    uint16_t frq;
+    uint16_t dty;
+    int16_t phs;
+} pwm_t;
+
+static volatile char ring[128];
+static volatile uint8_t ring_w = 0;
+
+NOINLINE void serial_write_c(char c) {
+    ring[ring_w++ & 127] = c;
+}
+
+/* Old path */
+
+char tx_buf[SER_BUFS_SIZE];
+
+NOINLINE char *itos(int num, int len, char *buf) {
+    char aux;
+
+    num = (num > 0) ? num : -1 * num;
+
+    for (int i = 0; i < len; i++) {
+        buf[i] = num % 10 + '0';
+        num = num / 10;
+    }
+
+    for (int i = 0; i < len / 2; i++) {
+        aux = buf[i];
+        buf[i] = buf[len - i - 1];
+        buf[len - i - 1] = aux;
+    }
+
+    buf[len] = '\0';
+
+    return buf;
+}
+
+NOINLINE int get_num_length(int num) {
+    if (num < 10) return 1;
+    else if (10 <= num && num < 100) return 2;
+    else if (100 <= num && num < 1000)return 3;
+    else return 4;
+}
+
+NOINLINE void serial_writeln_s(char *data) {
+    for (int i = 0; data[i] != '\0'; i++) serial_write_c(data[i]);
+    serial_write_c('\n');
+}
+
+NOINLINE void old_line(uint8_t j, pwm_t *pwm) {
+    char tmp_s[16];
+
+    strcpy(tx_buf, "^!,p,");
+    strcat(tx_buf, itos(j, get_num_length(j), tmp_s));
+    strcat(tx_buf, ",");
+    strcat(tx_buf, pwm->name);
+    strcat(tx_buf, ",");
+    strcat(tx_buf, itos(pwm->mode, get_num_length(pwm->mode), tmp_s));
+    strcat(tx_buf, ",");
+    strcat(tx_buf, itos(pwm->frq, get_num_length(pwm->frq), tmp_s));
+    strcat(tx_buf, ",");
+    strcat(tx_buf, itos(pwm->dty, get_num_length(pwm->dty), tmp_s));
+    strcat(tx_buf, ",");
+    strcat(tx_buf, itos(pwm->phs, get_num_length(pwm->phs), tmp_s));
+    serial_writeln_s(tx_buf);
+}
+
+/* New path */
+
+static char reply_tag[9] = "";
+static bool line_sent;
+static uint8_t line_len;
+static uint8_t line_size;
+static bool line_cut;
+
+NOINLINE uint8_t utos(uint16_t num, char *buf) {
+    static const uint16_t powers[] = { 10000, 1000, 100, 10 };
+    uint8_t len = 0;
+
+    for (uint8_t i = 0; i < 4; i++) {
+        char digit = '0';
+
+        while (num >= powers[i]) {
+            num -= powers[i];
+            digit++;
+        }
+
+        if (digit != '0' || len != 0) buf[len++] = digit;
+    }
+
+    buf[len++] = num + '0';
+    buf[len] = '\0';
+
+    return len;
+}
+
+NOINLINE void line_begin(const char *cmd, uint8_t size) {
+    line_len = 3;
+    line_size = size;
+    line_cut = false;
+    line_sent = true;
+
+    serial_write_c('^');
+
+    if (reply_tag[0] != '\0') {
+        serial_write_c('#');
+        for (char *c = reply_tag; *c != '\0'; c++, line_len++) serial_write_c(*c);
+        serial_write_c(',');
+        line_len += 2;
+    }
+
+    serial_write_c('!');
+    serial_write_c(',');
+
+    for (; *cmd != '\0'; cmd++, line_len++) serial_write_c(*cmd);
+}
+
+NOINLINE void line_field(const char *str, uint8_t len) {
+    if (line_len + len + 2 > line_size) {
+        line_cut = true;
+        return;
+    }
+
+    line_len += len + 1;
+
+    serial_write_c(',');
+    while (len--) serial_write_c(*str++);
+}
+
+NOINLINE void line_u(uint32_t num) {
+    char tmp_s[11];
+
+    if (num <= UINT16_MAX) line_field(tmp_s, utos(num, tmp_s));
+    else line_field(tmp_s, snprintf(tmp_s, sizeof(tmp_s), "%lu", (unsigned long)num));
+}
+
+NOINLINE void line_i(int16_t num) {
+    char tmp_s[7];
+
+    if (num >= 0) {
+        line_field(tmp_s, utos(num, tmp_s));
+    }
+    else {
+        tmp_s[0] = '-';
+        line_field(tmp_s, utos(-(int32_t)num, tmp_s + 1) + 1);
+    }
+}
+
+NOINLINE void line_s(const char *str) {
+    line_field(str, strlen(str));
+}
+
+NOINLINE bool line_end() {
+    serial_write_c('\n');
+    return !line_cut;
+}
+
+NOINLINE void new_line(uint8_t j, pwm_t *pwm) {
+    line_begin("p", SER_BUFS_SIZE);
+    line_u(j);
+    line_s(pwm->name);
+    line_u(pwm->mode);
+    line_u(pwm->frq);
+    line_u(pwm->dty);
+    line_i(pwm->phs);
+    line_end();
+}
+
+/* Benchmark */
+
+/**
+ * @brief Formats lines the given way and times them
+ *
+ * @param[in] format Way of formatting a line
+ * @param[in] pwms Channels to be formatted, in turns
+ * @param[in] lines Number of lines to be formatted
+ * @return double Time per line (ns)
+ */
+double time_lines(void (*format)(uint8_t, pwm_t *), pwm_t *pwms, long lines) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (long n = 0; n < lines; n++) format(n % NUM_PINS, &pwms[n % NUM_PINS]);
+
+    std::chrono::duration<double, std::nano> spent = std::chrono::steady_clock::now() - start;
+
+    return spent.count() / lines;
+}
+
+/**
+ * @brief Formats one line the given way and keeps what was written
+ *
+ * @param[in] format Way of formatting a line
+ * @param[in] pwm Channel to be formatted
+ * @param[out] out Where the line will be stored
+ */
+void sample_line(void (*format)(uint8_t, pwm_t *), pwm_t *pwm, char *out) {
+    uint8_t len;
+
+    ring_w = 0;
+    format(3, pwm);
+
+    for (len = 0; len < ring_w; len++) out[len] = ring[len];
+    out[len] = '\0';
+}
+
+int main() {
+    const long lines = 2000000;
+    pwm_t pwms[NUM_PINS];
+    double best_old = 1e99, best_new = 1e99;
+    char line_old[128], line_new[128];
+
+    // Names, modes and values of every length
+    for (int i = 0; i < NUM_PINS; i++) {
+        snprintf(pwms[i].name, sizeof(pwms[i].name), "Channel %d", i + 1);
+        pwms[i].mode = i % 3;
+        pwms[i].frq = 5 + i * 571;
+        pwms[i].dty = i * 13;
+        pwms[i].phs = i * 11;
+    }
+
+    for (int run = 0; run < 7; run++) {
+        double t_old = time_lines(old_line, pwms, lines);
+        double t_new = time_lines(new_line, pwms, lines);
+
+        if (t_old < best_old) best_old = t_old;
+        if (t_new < best_new) best_new = t_new;
+    }
+
+    sample_line(old_line, &pwms[3], line_old);
+    sample_line(new_line, &pwms[3], line_new);
+
+    printf("old %.1f ns/line\n", best_old);
+    printf("new %.1f ns/line (%.0f%% less)\n", best_new, 100 * (1 - best_new / best_old));
+    printf("old: %s", line_old);
+    printf("new: %s", line_new);
+
+    return strcmp(line_old, line_new) != 0;
+}
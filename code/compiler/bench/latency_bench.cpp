@@ -0,0 +1,168 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Host benchmark of the firmware's event-to-handler latency
+ * @details Times how long an event queued from an interrupt waits
+ * until the main loop hands it over, with the two loops the firmware
+ * has had:
+ * - Old: delay(1) at the start of every pass, then the queue is
+ *   polled.
+ * - New: interrupts are disabled while checking the queue and the
+ *   loop only sleeps if it is empty, as loop() in src/PWM_BOX.cpp
+ *   does now with cli/sei/sleep_cpu.
+ *
+ * A signal stands in for the interrupt, a timer raising it every
+ * EVENT_PERIOD_US. Blocking signals stands in for cli, and
+ * sigsuspend for sei followed by sleep_cpu, since both wake up on
+ * a signal that was pending when they were called.
+ *
+ * Run with "make bench" from code/compiler. The host adds its own
+ * signal and scheduling delays on top of the loop's. On the device,
+ * the last field of "^?,e" reports the worst wait, and DEBUG_LATENCY
+ * builds toggle PB6 to check it with a scope.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <signal.h>
+#include <sys/time.h>
+
+#define EVENTS 1000
+#define EVENT_PERIOD_US 2300  // Not a multiple of 1 ms, so events land anywhere in a delay
+#define QUEUE_SIZE 16
+
+static int64_t queue[QUEUE_SIZE];  // Time each event was queued (ns)
+static std::atomic<uint8_t> queue_w(0);
+static std::atomic<uint8_t> queue_r(0);
+
+/**
+ * @brief Gets the time from a monotonic clock
+ *
+ * @return int64_t Current time (ns)
+ */
+int64_t now_ns() {
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * @brief Waits 1 ms, like delay(1), which interrupts don't cut short
+ */
+void delay_1ms() {
+    struct timespec until;
+
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_nsec += 1000000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_nsec -= 1000000000;
+        until.tv_sec++;
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0) {}
+}
+
+/**
+ * @brief Stands in for an interrupt queueing an event
+ */
+void event_isr(int) {
+    uint8_t w = queue_w.load(std::memory_order_relaxed);
+
+    if ((uint8_t)(w - queue_r.load(std::memory_order_acquire)) == QUEUE_SIZE) return;
+
+    queue[w % QUEUE_SIZE] = now_ns();
+    queue_w.store(w + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Takes the oldest event, if any
+ *
+ * @param[out] queued Time the event was queued (ns)
+ * @return true An event was taken
+ * @return false The queue is empty
+ */
+bool event_pop(int64_t *queued) {
+    uint8_t r = queue_r.load(std::memory_order_relaxed);
+
+    if (r == queue_w.load(std::memory_order_acquire)) return false;
+
+    *queued = queue[r % QUEUE_SIZE];
+    queue_r.store(r + 1, std::memory_order_release);
+
+    return true;
+}
+
+/**
+ * @brief Runs a main loop until enough events have been handled
+ *
+ * @param[in] sleeping Sleep until an event is queued, instead of
+ * waiting 1 ms on every pass
+ * @return std::vector<double> Wait of every event (us)
+ */
+std::vector<double> run_loop(bool sleeping) {
+    std::vector<double> waits;
+    sigset_t alarm, unmasked;
+    int64_t queued;
+
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    sigprocmask(SIG_SETMASK, NULL, &unmasked);
+    sigdelset(&unmasked, SIGALRM);
+
+    while (event_pop(&queued)) {}
+
+    struct itimerval timer = { { 0, EVENT_PERIOD_US }, { 0, EVENT_PERIOD_US } };
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    while (waits.size() < EVENTS) {
+        if (!sleeping) delay_1ms();
+
+        while (event_pop(&queued)) {
+            waits.push_back((now_ns() - queued) / 1000.0);
+        }
+
+        if (sleeping) {
+            sigprocmask(SIG_BLOCK, &alarm, NULL);  // cli()
+            if (queue_r.load() == queue_w.load()) sigsuspend(&unmasked);  // sei(), sleep_cpu()
+            sigprocmask(SIG_UNBLOCK, &alarm, NULL);  // sei()
+        }
+    }
+
+    timer = {};
+    setitimer(ITIMER_REAL, &timer, NULL);
+
+    return waits;
+}
+
+/**
+ * @brief Prints how long events waited
+ *
+ * @param[in] name Loop the waits were taken with
+ * @param[in] waits Wait of every event (us)
+ */
+void print_waits(const char *name, std::vector<double> waits) {
+    std::sort(waits.begin(), waits.end());
+
+    printf("%s min %.1f us, median %.1f us, 99%% %.1f us, max %.1f us\n", name,
+           waits.front(), waits[waits.size() / 2], waits[waits.size() * 99 / 100], waits.back());
+}
+
+int main() {
+    struct sigaction action = {};
+
+    action.sa_handler = event_isr;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+
+    print_waits("delay(1)", run_loop(false));
+    print_waits("sleep   ", run_loop(true));
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <emitter.h> @endcode
+ *
+ * @brief Generates the firmware's formats from a validated
+ * pattern
+ */
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <string>
+
+#include "pattern.h"
+
+/**
+ * @brief Output formats
+ */
+enum format_t {
+    SERIAL_FORMAT, /**< Serial protocol lines, ready to be sent to a device */
+    PROGMEM_FORMAT /**< C header with PROGMEM tables of slot_t and playlist_t */
+};
+
+/**
+ * @brief Generates the serial protocol lines that store the
+ * whole pattern in a device
+ * @details Same sequence pwmbox.py sends: slots replace the
+ * device's library, playlists not in the pattern are deleted
+ * 
+ * @param[in] pat Validated pattern
+ * @return std::string One command per line
+ */
+std::string emit_serial(const pattern_t &pat);
+
+/**
+ * @brief Generates a C header to embed the pattern in the
+ * firmware
+ * 
+ * @param[in] pat Validated pattern
+ * @param[in] ident Prefix for the generated symbols
+ * @return std::string Header contents
+ */
+std::string emit_progmem(const pattern_t &pat, const std::string &ident);
+
+/**
+ * @brief Turns a file name into a valid C identifier
+ * 
+ * @param[in] path File path
+ * @return std::string Identifier
+ */
+std::string make_ident(const std::string &path);
+
+#endif // EMITTER_H
@@ -0,0 +1,44 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <parser.h> @endcode
+ *
+ * @brief Reads pattern description files
+ * @details Patterns are plain text, one statement per line.
+ * Anything after a '#' is a comment, and names with spaces go
+ * between double quotes:
+ * @code
+ * slot "Low beam"
+ *     pwm 0 DRL pwm 100 50 0      # idx name mode frq(Hz) dty(%) phs(%)
+ *     pwm 1 Blinker on
+ * end
+ *
+ * playlist Demo
+ *     step "Low beam" 2.0 fade 0.5  # slot dwell(s) [fade(s)]
+ *     step @0 1.5                 # slots can also be referenced by index
+ * end
+ *
+ * default "Low beam"
+ * @endcode
+ * Channels that aren't set default to OFF.
+ */
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <istream>
+
+#include "pattern.h"
+
+/**
+ * @brief Parses a pattern description
+ * 
+ * @param[in] in Stream to read the pattern from
+ * @param[in,out] res Result where the pattern and any syntax
+ * errors are stored. res.pattern.file must be set beforehand
+ */
+void parse_pattern(std::istream &in, result_t &res);
+
+#endif // PARSER_H
@@ -0,0 +1,120 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <pattern.h> @endcode
+ *
+ * @brief In-memory representation of a compiled pattern
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+/**
+ * @brief Modes a channel can be set to, same values as the
+ * firmware's pin_mode
+ */
+enum channel_mode {
+    OFF_MODE = 0, /**< Logic 0 */
+    PWM_MODE = 1, /**< PWM output */
+    ON_MODE = 2 /**< Logic 1 */
+};
+
+/**
+ * @brief A single channel of a slot
+ */
+struct channel_t {
+    bool defined = false; /**< Whether the pattern sets this channel */
+    int line = 0; /**< Line where the channel is defined */
+
+    std::string name; /**< Signal name */
+    uint8_t mode = OFF_MODE; /**< Signal mode */
+    uint16_t frq = 0; /**< Frequency, in tenths of Hz */
+    uint16_t dty = 0; /**< Duty cycle (%) */
+    int16_t phs = 0; /**< Phase (%) */
+};
+
+/**
+ * @brief A slot, as stored in the device
+ */
+struct slot_def_t {
+    int line = 0; /**< Line where the slot is defined */
+
+    std::string name; /**< Slot name */
+    channel_t channels[NUM_PINS]; /**< The slot's channels */
+};
+
+/**
+ * @brief A single step of a playlist
+ */
+struct step_def_t {
+    int line = 0; /**< Line where the step is defined */
+
+    std::string slot; /**< Name of the slot to load, or its index prefixed by an at sign */
+    int slot_idx = -1; /**< Resolved slot index, -1 until validated */
+    uint32_t dwell = 0; /**< Dwell time, in tenths of a second */
+    uint32_t fade = 0; /**< Fade time, in tenths of a second */
+};
+
+/**
+ * @brief A playlist, as stored in the device
+ */
+struct playlist_def_t {
+    int line = 0; /**< Line where the playlist is defined */
+
+    std::string name; /**< Playlist name */
+    std::vector<step_def_t> steps; /**< The playlist's steps */
+};
+
+/**
+ * @brief A whole pattern file
+ */
+struct pattern_t {
+    std::string file; /**< Source file */
+
+    std::vector<slot_def_t> slots; /**< Slots, in upload order */
+    std::vector<playlist_def_t> playlists; /**< Playlists, in upload order */
+
+    std::string default_slot; /**< Name of the default slot, or its index prefixed by an at sign. Empty if none */
+    int default_line = 0; /**< Line where the default slot is set */
+    int default_idx = -1; /**< Resolved default slot index */
+};
+
+/**
+ * @brief Error or warning found while compiling
+ */
+struct diagnostic_t {
+    std::string file; /**< Source file */
+    int line; /**< Source line, 0 if not related to a line */
+    bool error; /**< Error (true) or warning (false) */
+    std::string msg; /**< Human readable message */
+};
+
+/**
+ * @brief Result of compiling a single file
+ */
+struct result_t {
+    pattern_t pattern; /**< Parsed pattern */
+    std::vector<diagnostic_t> diags; /**< Diagnostics, in source order */
+    std::string output; /**< Generated output */
+
+    /**
+     * @brief Checks whether any error was found
+     */
+    bool failed() const {
+        for (const diagnostic_t &d : diags) {
+            if (d.error) return true;
+        }
+
+        return false;
+    }
+};
+
+#endif // PATTERN_H
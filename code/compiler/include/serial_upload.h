@@ -0,0 +1,31 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <serial_upload.h> @endcode
+ *
+ * @brief Sends compiled patterns to a device (POSIX only)
+ */
+
+#ifndef SERIAL_UPLOAD_H
+#define SERIAL_UPLOAD_H
+
+#include <string>
+
+/**
+ * @brief Opens the port, checks the handshake and sends the
+ * serial protocol lines one by one
+ * 
+ * @param[in] port Serial port (Eg. /dev/ttyUSB0)
+ * @param[in] lines Output of emit_serial()
+ * @param[in] line_delay_ms Time to wait after each line, since
+ * the device doesn't acknowledge them
+ * @param[out] err Error description, if any
+ * @return true If everything has been sent
+ * @return false If the port couldn't be used or the device
+ * didn't answer the handshake
+ */
+bool upload(const std::string &port, const std::string &lines, unsigned line_delay_ms, std::string &err);
+
+#endif // SERIAL_UPLOAD_H
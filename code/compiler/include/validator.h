@@ -0,0 +1,51 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <validator.h> @endcode
+ *
+ * @brief Checks patterns against the firmware's limits before
+ * they reach a device
+ */
+
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+
+#include "pattern.h"
+
+/**
+ * @brief Frequency, duty cycle and phase a channel really
+ * outputs once the firmware quantizes it
+ */
+struct quantized_t {
+    uint32_t cycles_total; /**< Interrupt cycles per period */
+    uint32_t cycles_on; /**< Interrupt cycles the pin is HIGH */
+    double frq; /**< Real frequency (Hz) */
+    double dty; /**< Real duty cycle (%) */
+    double phs; /**< Real phase (%) */
+};
+
+/**
+ * @brief Reproduces set_pin_config() and set_pin_phase() from
+ * the firmware's virtual_PWM.c
+ * 
+ * @param[in] frq Frequency, in tenths of Hz
+ * @param[in] dty Duty cycle (%)
+ * @param[in] phs Phase (%)
+ * @return quantized_t What the device will actually output
+ */
+quantized_t quantize(uint32_t frq, uint32_t dty, int16_t phs);
+
+/**
+ * @brief Checks pin conflicts, ranges, timing limits and
+ * quantization errors, and resolves slot references
+ * 
+ * @param[in,out] res Parsed pattern, new diagnostics are added
+ * to it
+ * @param[in] tolerance Maximum quantization error allowed before
+ * warning (% of the frequency, points of duty cycle and phase)
+ */
+void validate_pattern(result_t &res, double tolerance);
+
+#endif // VALIDATOR_H
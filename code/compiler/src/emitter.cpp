@@ -0,0 +1,157 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Generates the firmware's formats from a validated
+ * pattern
+ */
+
+#include "emitter.h"
+
+#include <cctype>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+
+/**
+ * @brief Escapes a name to be used as a C string literal
+ */
+std::string c_string(const std::string &s) {
+    std::string out = "\"";
+
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+
+    return out + "\"";
+}
+
+}  // namespace
+
+std::string emit_serial(const pattern_t &pat) {
+    std::ostringstream out;
+
+    out << "^!,n," << pat.slots.size() << "\n";
+
+    for (size_t i = 0; i < pat.slots.size(); i++) {
+        const slot_def_t &slot = pat.slots[i];
+
+        out << "^!,s," << i << "," << slot.name << "\n";
+
+        for (int j = 0; j < NUM_PINS; j++) {
+            const channel_t &ch = slot.channels[j];
+
+            out << "^!,p," << j << "," << ch.name << "," << (int)ch.mode << ","
+                << ch.frq << "," << ch.dty << "," << ch.phs << "\n";
+        }
+    }
+
+    for (size_t i = 0; i < NUM_PLAYLISTS; i++) {
+        if (i >= pat.playlists.size()) {
+            out << "^!,l," << i << ",-,0\n";  // Deletes it
+            continue;
+        }
+
+        const playlist_def_t &pl = pat.playlists[i];
+
+        out << "^!,l," << i << "," << pl.name << "," << pl.steps.size() << "\n";
+
+        for (size_t j = 0; j < pl.steps.size(); j++) {
+            const step_def_t &step = pl.steps[j];
+
+            out << "^!,t," << j << "," << step.slot_idx << "," << step.dwell << ","
+                << step.fade << "\n";
+        }
+    }
+
+    if (pat.default_idx != -1) out << "^!,d," << pat.default_idx << "\n";
+
+    return out.str();
+}
+
+std::string emit_progmem(const pattern_t &pat, const std::string &ident) {
+    std::ostringstream out;
+    std::string guard = ident;
+
+    for (char &c : guard) c = std::toupper(c);
+    guard += "_PATTERN_H";
+
+    out << "/**\n"
+        << " * @file\n"
+        << " * @brief Generated by pattern_compiler from "
+        << std::filesystem::path(pat.file).filename().string() << ", do not edit\n"
+        << " */\n\n"
+        << "#ifndef " << guard << "\n"
+        << "#define " << guard << "\n\n"
+        << "#include <avr/pgmspace.h>\n"
+        << "#include \"sys/eeprom_control.h\"\n\n";
+
+    out << "#define " << guard.substr(0, guard.size() - 2) << "_NUM_SLOTS " << pat.slots.size() << "\n"
+        << "#define " << guard.substr(0, guard.size() - 2) << "_NUM_PLAYLISTS " << pat.playlists.size()
+        << "\n";
+
+    if (pat.default_idx != -1) {
+        out << "#define " << guard.substr(0, guard.size() - 2) << "_DEFAULT_SLOT " << pat.default_idx
+            << "\n";
+    }
+
+    out << "\n";
+
+    if (!pat.slots.empty()) {
+        out << "const slot_t " << ident << "_slots[" << pat.slots.size() << "] PROGMEM = {\n";
+
+        for (const slot_def_t &slot : pat.slots) {
+            out << "    { " << c_string(slot.name) << ", true, {\n";
+
+            for (int j = 0; j < NUM_PINS; j++) {
+                const channel_t &ch = slot.channels[j];
+
+                out << "        { " << c_string(ch.name) << ", " << (int)ch.mode << ", " << ch.frq
+                    << ", " << ch.dty << ", (uint16_t)" << ch.phs << " }"
+                    << (j == NUM_PINS - 1 ? "\n" : ",\n");
+            }
+
+            out << "    } },\n";
+        }
+
+        out << "};\n\n";
+    }
+
+    if (!pat.playlists.empty()) {
+        out << "const playlist_t " << ident << "_playlists[" << pat.playlists.size() << "] PROGMEM = {\n";
+
+        for (const playlist_def_t &pl : pat.playlists) {
+            out << "    { " << c_string(pl.name) << ", " << pl.steps.size() << ", {";
+
+            for (size_t j = 0; j < pl.steps.size(); j++) {
+                const step_def_t &step = pl.steps[j];
+
+                out << (j == 0 ? " " : ", ") << "{ " << step.slot_idx << ", " << step.dwell << ", "
+                    << step.fade << " }";
+            }
+
+            out << " } },\n";
+        }
+
+        out << "};\n\n";
+    }
+
+    out << "#endif /* " << guard << " */\n";
+
+    return out.str();
+}
+
+std::string make_ident(const std::string &path) {
+    std::string ident = std::filesystem::path(path).stem().string();
+
+    for (char &c : ident) {
+        if (!std::isalnum((unsigned char)c)) c = '_';
+        else c = std::tolower(c);
+    }
+
+    if (ident.empty() || std::isdigit((unsigned char)ident[0])) ident = "p_" + ident;
+
+    return ident;
+}
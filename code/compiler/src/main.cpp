@@ -0,0 +1,261 @@
+/**
+ * @mainpage
+ * Pattern compiler for the PWM Box headlight tester
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emitter.h"
+#include "parser.h"
+#include "serial_upload.h"
+#include "validator.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Command line options
+ */
+struct options_t {
+    std::vector<std::string> inputs; /**< Pattern files, directories are expanded */
+    std::string output; /**< Output file, or directory when compiling several files */
+    format_t format = SERIAL_FORMAT; /**< Output format */
+    unsigned jobs = 0; /**< Worker threads, 0 for one per core */
+    double tolerance = 1.0; /**< Quantization tolerance */
+    bool check_only = false; /**< Don't generate any output */
+    bool werror = false; /**< Treat warnings as errors */
+    std::string port; /**< Device to upload to, if any */
+    unsigned line_delay = 500; /**< Delay between uploaded lines (ms) */
+};
+
+namespace {
+
+void usage(const char *prog) {
+    std::cerr
+        << "Usage: " << prog << " [options] <pattern|directory>...\n"
+        << "\n"
+        << "Compiles PWM Box pattern descriptions into the device's formats.\n"
+        << "Directories are searched for *.pat files, which are compiled in parallel.\n"
+        << "\n"
+        << "Options:\n"
+        << "  -o <path>    Output file (one input) or directory (several inputs).\n"
+        << "               Defaults to stdout for a single input\n"
+        << "  -f <format>  serial (default) or progmem\n"
+        << "  -j <n>       Parallel jobs (default: one per core)\n"
+        << "  -t <tol>     Quantization tolerance, in % (default: 1)\n"
+        << "  -c           Only check the patterns\n"
+        << "  -W           Treat warnings as errors\n"
+        << "  -u <port>    Upload the pattern to a device (one input)\n"
+        << "  -d <ms>      Delay between uploaded lines (default: 500)\n"
+        << "  -h           Show this help\n";
+}
+
+bool parse_args(int argc, char **argv, options_t &opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "-h") return false;
+        else if (arg == "-c") opt.check_only = true;
+        else if (arg == "-W") opt.werror = true;
+        else if (arg == "-o" && has_value) opt.output = argv[++i];
+        else if (arg == "-u" && has_value) opt.port = argv[++i];
+        else if (arg == "-j" && has_value) opt.jobs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "-t" && has_value) opt.tolerance = std::strtod(argv[++i], nullptr);
+        else if (arg == "-d" && has_value) opt.line_delay = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "-f" && has_value) {
+            std::string fmt = argv[++i];
+
+            if (fmt == "serial") opt.format = SERIAL_FORMAT;
+            else if (fmt == "progmem") opt.format = PROGMEM_FORMAT;
+            else {
+                std::cerr << "Unknown format '" << fmt << "'\n";
+                return false;
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option '" << arg << "'\n";
+            return false;
+        }
+        else opt.inputs.push_back(arg);
+    }
+
+    return !opt.inputs.empty();
+}
+
+/**
+ * @brief Expands directories into the pattern files they contain
+ */
+bool collect_files(const options_t &opt, std::vector<std::string> &files, bool &batch) {
+    batch = opt.inputs.size() > 1;
+
+    for (const std::string &in : opt.inputs) {
+        std::error_code ec;
+
+        if (fs::is_directory(in, ec)) {
+            std::vector<std::string> found;
+
+            for (const fs::directory_entry &e : fs::recursive_directory_iterator(in, ec)) {
+                if (e.is_regular_file() && e.path().extension() == ".pat") found.push_back(e.path().string());
+            }
+
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+            batch = true;
+        }
+        else if (fs::is_regular_file(in, ec)) {
+            files.push_back(in);
+        }
+        else {
+            std::cerr << in << ": no such file or directory\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void compile_file(const std::string &file, const options_t &opt, result_t &res) {
+    std::ifstream in(file);
+
+    res.pattern.file = file;
+
+    if (!in) {
+        res.diags.push_back({ file, 0, true, "can't open file" });
+        return;
+    }
+
+    parse_pattern(in, res);
+
+    // Validating a pattern with syntax errors would only add noise
+    if (res.failed()) return;
+
+    validate_pattern(res, opt.tolerance);
+
+    if (opt.werror) {
+        for (diagnostic_t &d : res.diags) d.error = true;
+    }
+
+    if (res.failed() || opt.check_only) return;
+
+    if (opt.format == SERIAL_FORMAT) res.output = emit_serial(res.pattern);
+    else res.output = emit_progmem(res.pattern, make_ident(file));
+}
+
+/**
+ * @brief Compiles every file, spreading them across worker
+ * threads
+ */
+void compile_all(const std::vector<std::string> &files, const options_t &opt, std::vector<result_t> &results) {
+    unsigned jobs = opt.jobs ? opt.jobs : std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+
+    results.resize(files.size());
+    jobs = std::min<size_t>(jobs, files.size());
+
+    for (unsigned i = 0; i < jobs; i++) {
+        workers.emplace_back([&]() {
+            for (size_t j = next++; j < files.size(); j = next++) {
+                compile_file(files[j], opt, results[j]);
+            }
+        });
+    }
+
+    for (std::thread &t : workers) t.join();
+}
+
+std::string output_path(const options_t &opt, const std::string &file) {
+    fs::path out = fs::path(opt.output) / fs::path(file).stem();
+    out += opt.format == SERIAL_FORMAT ? ".txt" : ".h";
+    return out.string();
+}
+
+bool write_file(const std::string &path, const std::string &data) {
+    std::ofstream out(path, std::ios::binary);
+    out << data;
+    return bool(out);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    options_t opt;
+    std::vector<std::string> files;
+    std::vector<result_t> results;
+    bool batch;
+
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!collect_files(opt, files, batch)) return 2;
+
+    if (batch && !opt.check_only && opt.output.empty()) {
+        std::cerr << "An output directory (-o) is needed to compile several patterns\n";
+        return 2;
+    }
+
+    if (!opt.port.empty() && (batch || opt.format != SERIAL_FORMAT)) {
+        std::cerr << "Uploading needs a single pattern in serial format\n";
+        return 2;
+    }
+
+    compile_all(files, opt, results);
+
+    // Reported in input order, no matter which thread finished first
+    size_t failed = 0;
+
+    for (const result_t &res : results) {
+        for (const diagnostic_t &d : res.diags) {
+            std::cerr << d.file << ":";
+            if (d.line) std::cerr << d.line << ":";
+            std::cerr << (d.error ? " error: " : " warning: ") << d.msg << "\n";
+        }
+
+        if (res.failed()) failed++;
+    }
+
+    if (!opt.check_only) {
+        if (batch) fs::create_directories(opt.output);
+
+        for (size_t i = 0; i < files.size(); i++) {
+            if (results[i].failed()) continue;
+
+            if (!batch && opt.output.empty()) {
+                if (opt.port.empty()) std::cout << results[i].output;
+            }
+            else {
+                std::string path = batch ? output_path(opt, files[i]) : opt.output;
+
+                if (!write_file(path, results[i].output)) {
+                    std::cerr << path << ": can't write file\n";
+                    failed++;
+                }
+            }
+        }
+    }
+
+    if (!opt.port.empty() && failed == 0) {
+        std::string err;
+
+        if (!upload(opt.port, results[0].output, opt.line_delay, err)) {
+            std::cerr << err << "\n";
+            return 1;
+        }
+    }
+
+    if (batch) std::cerr << files.size() - failed << " of " << files.size() << " patterns compiled\n";
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Reads pattern description files
+ */
+
+#include "parser.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Parser state
+ */
+enum block_t {
+    TOP_BLOCK, /**< Outside any block */
+    SLOT_BLOCK, /**< Inside a slot block */
+    PLAYLIST_BLOCK /**< Inside a playlist block */
+};
+
+void error(result_t &res, int line, const std::string &msg) {
+    res.diags.push_back({ res.pattern.file, line, true, msg });
+}
+
+void warning(result_t &res, int line, const std::string &msg) {
+    res.diags.push_back({ res.pattern.file, line, false, msg });
+}
+
+/**
+ * @brief Splits a line into words, honoring quotes and comments
+ */
+bool tokenize(const std::string &line, std::vector<std::string> &tokens) {
+    std::string cur;
+    bool in_quotes = false;
+    bool in_token = false;
+
+    for (char c : line) {
+        if (in_quotes) {
+            if (c == '"') in_quotes = false;
+            else cur += c;
+        }
+        else if (c == '"') {
+            in_quotes = true;
+            in_token = true;
+        }
+        else if (c == '#' && !in_token) {
+            break;
+        }
+        else if (c == ' ' || c == '\t' || c == '\r') {
+            if (in_token) tokens.push_back(cur);
+            cur.clear();
+            in_token = false;
+        }
+        else {
+            cur += c;
+            in_token = true;
+        }
+    }
+
+    if (in_token) tokens.push_back(cur);
+
+    return !in_quotes;
+}
+
+bool parse_int(const std::string &s, long &out) {
+    char *end;
+    out = std::strtol(s.c_str(), &end, 10);
+    return !s.empty() && *end == '\0';
+}
+
+/**
+ * @brief Parses a decimal number into tenths, warning if it has
+ * to be rounded
+ */
+bool parse_tenths(result_t &res, int line, const std::string &s, long &out) {
+    char *end;
+    double value = std::strtod(s.c_str(), &end);
+
+    if (s.empty() || *end != '\0' || !std::isfinite(value)) return false;
+
+    out = std::lround(value * 10);
+
+    if (std::fabs(value * 10 - out) > 1e-6) {
+        warning(res, line, "'" + s + "' rounded to " + std::to_string(out / 10) +
+                "." + std::to_string(std::labs(out % 10)) + ", the device works in tenths");
+    }
+
+    return true;
+}
+
+void parse_channel(result_t &res, int line, const std::vector<std::string> &tok) {
+    slot_def_t &slot = res.pattern.slots.back();
+    long idx;
+
+    if (tok.size() < 4) {
+        error(res, line, "expected 'pwm <idx> <name> <off|on|pwm> [frq dty [phs]]'");
+        return;
+    }
+
+    if (!parse_int(tok[1], idx) || idx < 0 || idx >= NUM_PINS) {
+        error(res, line, "channel index '" + tok[1] + "' out of range (0 - " +
+              std::to_string(NUM_PINS - 1) + ")");
+        return;
+    }
+
+    channel_t &ch = slot.channels[idx];
+
+    if (ch.defined) {
+        error(res, line, "channel " + tok[1] + " already set on line " + std::to_string(ch.line));
+        return;
+    }
+
+    ch.defined = true;
+    ch.line = line;
+    ch.name = tok[2];
+
+    if (tok[3] == "off" || tok[3] == "on") {
+        ch.mode = tok[3] == "on" ? ON_MODE : OFF_MODE;
+
+        if (tok.size() > 4) warning(res, line, "parameters ignored for '" + tok[3] + "' channels");
+
+        return;
+    }
+    else if (tok[3] != "pwm") {
+        error(res, line, "unknown mode '" + tok[3] + "', expected off, on or pwm");
+        return;
+    }
+
+    ch.mode = PWM_MODE;
+
+    long frq, dty, phs = 0;
+
+    if (tok.size() < 6 || tok.size() > 7) {
+        error(res, line, "expected 'pwm <idx> <name> pwm <frq> <dty> [phs]'");
+        return;
+    }
+
+    if (!parse_tenths(res, line, tok[4], frq)) {
+        error(res, line, "invalid frequency '" + tok[4] + "'");
+        return;
+    }
+
+    if (!parse_int(tok[5], dty)) {
+        error(res, line, "invalid duty cycle '" + tok[5] + "'");
+        return;
+    }
+
+    if (tok.size() == 7 && !parse_int(tok[6], phs)) {
+        error(res, line, "invalid phase '" + tok[6] + "'");
+        return;
+    }
+
+    // Range checks are left to the validator, just keep the values sane
+    ch.frq = (uint16_t)std::min(std::max(frq, -1L), 65535L);
+    ch.dty = (uint16_t)std::min(std::max(dty, -1L), 65535L);
+    ch.phs = (int16_t)std::min(std::max(phs, -32768L), 32767L);
+
+    if (frq < 0) error(res, line, "negative frequency");
+    if (dty < 0) error(res, line, "negative duty cycle");
+}
+
+void parse_step(result_t &res, int line, const std::vector<std::string> &tok) {
+    step_def_t step;
+    long dwell, fade = 0;
+
+    step.line = line;
+
+    if (tok.size() != 3 && !(tok.size() == 5 && tok[3] == "fade")) {
+        error(res, line, "expected 'step <slot> <dwell> [fade <time>]'");
+        return;
+    }
+
+    step.slot = tok[1];
+
+    if (!parse_tenths(res, line, tok[2], dwell) || dwell < 0) {
+        error(res, line, "invalid dwell time '" + tok[2] + "'");
+        return;
+    }
+
+    if (tok.size() == 5 && (!parse_tenths(res, line, tok[4], fade) || fade < 0)) {
+        error(res, line, "invalid fade time '" + tok[4] + "'");
+        return;
+    }
+
+    step.dwell = dwell;
+    step.fade = fade;
+
+    res.pattern.playlists.back().steps.push_back(step);
+}
+
+}  // namespace
+
+void parse_pattern(std::istream &in, result_t &res) {
+    std::string text;
+    block_t block = TOP_BLOCK;
+    int block_line = 0;
+    int line = 0;
+
+    while (std::getline(in, text)) {
+        std::vector<std::string> tok;
+        line++;
+
+        if (!tokenize(text, tok)) {
+            error(res, line, "unterminated quotes");
+            continue;
+        }
+
+        if (tok.empty()) continue;
+
+        const std::string &kw = tok[0];
+
+        if (kw == "end") {
+            if (block == TOP_BLOCK) error(res, line, "'end' outside of a block");
+            block = TOP_BLOCK;
+        }
+        else if (block == SLOT_BLOCK) {
+            if (kw == "pwm") parse_channel(res, line, tok);
+            else error(res, line, "unexpected '" + kw + "' inside a slot");
+        }
+        else if (block == PLAYLIST_BLOCK) {
+            if (kw == "step") parse_step(res, line, tok);
+            else error(res, line, "unexpected '" + kw + "' inside a playlist");
+        }
+        else if (kw == "slot" || kw == "playlist") {
+            if (tok.size() != 2) {
+                error(res, line, "expected '" + kw + " <name>'");
+                continue;
+            }
+
+            if (kw == "slot") {
+                res.pattern.slots.emplace_back();
+                res.pattern.slots.back().line = line;
+                res.pattern.slots.back().name = tok[1];
+                block = SLOT_BLOCK;
+            }
+            else {
+                res.pattern.playlists.emplace_back();
+                res.pattern.playlists.back().line = line;
+                res.pattern.playlists.back().name = tok[1];
+                block = PLAYLIST_BLOCK;
+            }
+
+            block_line = line;
+        }
+        else if (kw == "default") {
+            if (tok.size() != 2) error(res, line, "expected 'default <slot>'");
+            else if (!res.pattern.default_slot.empty()) error(res, line, "default slot set twice");
+            else {
+                res.pattern.default_slot = tok[1];
+                res.pattern.default_line = line;
+            }
+        }
+        else {
+            error(res, line, "unknown statement '" + kw + "'");
+        }
+    }
+
+    if (block != TOP_BLOCK) error(res, block_line, "block is missing its 'end'");
+}
@@ -0,0 +1,102 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Sends compiled patterns to a device (POSIX only)
+ */
+
+#include "serial_upload.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+bool write_all(int fd, const std::string &data) {
+    size_t done = 0;
+
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        done += n;
+    }
+
+    return tcdrain(fd) == 0;
+}
+
+/**
+ * @brief Reads a line, giving up after the port's timeout
+ */
+std::string read_line(int fd) {
+    std::string line;
+    char c;
+
+    while (read(fd, &c, 1) == 1) {
+        if (c == '\n') break;
+        line += c;
+    }
+
+    return line;
+}
+
+}  // namespace
+
+bool upload(const std::string &port, const std::string &lines, unsigned line_delay_ms, std::string &err) {
+    int fd = open(port.c_str(), O_RDWR | O_NOCTTY);
+
+    if (fd < 0) {
+        err = port + ": " + std::strerror(errno);
+        return false;
+    }
+
+    termios tty;
+    tcgetattr(fd, &tty);
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B115200);  // SER_BAUD
+    cfsetospeed(&tty, B115200);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 10;  // 1 s read timeout
+
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        err = port + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(2));  // Opening the port resets the board
+    tcflush(fd, TCIFLUSH);
+
+    if (!write_all(fd, "^?,@\n") || read_line(fd).find("^!,@") == std::string::npos) {
+        err = port + ": no PWM Box answered the handshake";
+        close(fd);
+        return false;
+    }
+
+    std::istringstream in(lines);
+    std::string line;
+
+    while (std::getline(in, line)) {
+        if (!write_all(fd, line + "\n")) {
+            err = port + ": " + std::strerror(errno);
+            close(fd);
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(line_delay_ms));
+    }
+
+    close(fd);
+    return true;
+}
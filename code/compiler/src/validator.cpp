@@ -0,0 +1,223 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Checks patterns against the firmware's limits before
+ * they reach a device
+ */
+
+#include "validator.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+namespace {
+
+void error(result_t &res, int line, const std::string &msg) {
+    res.diags.push_back({ res.pattern.file, line, true, msg });
+}
+
+void warning(result_t &res, int line, const std::string &msg) {
+    res.diags.push_back({ res.pattern.file, line, false, msg });
+}
+
+std::string fmt(double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.2f", value);
+    return buf;
+}
+
+/**
+ * @brief Checks that a name fits in the device and doesn't break
+ * the serial protocol
+ */
+void check_name(result_t &res, int line, const std::string &name, size_t size, const char *what) {
+    if (name.empty()) error(res, line, std::string(what) + " name can't be empty");
+
+    if (name.size() > size - 1) {
+        error(res, line, std::string(what) + " name '" + name + "' is longer than " +
+              std::to_string(size - 1) + " characters");
+    }
+
+    if (name.find_first_of(",^\n") != std::string::npos) {
+        error(res, line, std::string(what) + " name '" + name + "' can't contain ',' or '^'");
+    }
+}
+
+/**
+ * @brief Finds a slot by name or by '@' prefixed index
+ */
+int resolve_slot(const pattern_t &pat, const std::string &ref) {
+    if (ref.size() > 1 && ref[0] == '@') {
+        char *end;
+        long idx = std::strtol(ref.c_str() + 1, &end, 10);
+
+        if (*end != '\0' || idx < 0 || idx >= (long)pat.slots.size()) return -1;
+
+        return idx;
+    }
+
+    for (size_t i = 0; i < pat.slots.size(); i++) {
+        if (pat.slots[i].name == ref) return i;
+    }
+
+    return -1;
+}
+
+void validate_channel(result_t &res, channel_t &ch, int idx, double tolerance) {
+    const int line = ch.line;
+    const std::string label = "channel " + std::to_string(idx);
+
+    check_name(res, line, ch.name, EE_PWM_NAME_SIZE, "channel");
+
+    if (ch.mode != PWM_MODE) return;
+
+    if (ch.frq == 0) {
+        error(res, line, label + ": frequency can't be 0 in pwm mode");
+        return;
+    }
+
+    if (ch.frq > PWM_MAX_FRQ) {
+        error(res, line, label + ": frequency " + fmt(ch.frq / 10.0) + " Hz above the " +
+              fmt(PWM_MAX_FRQ / 10.0) + " Hz limit");
+        return;
+    }
+
+    if (ch.dty > 100) {
+        error(res, line, label + ": duty cycle " + std::to_string(ch.dty) + "% above 100%");
+        return;
+    }
+
+    if (ch.phs < -99 || ch.phs > 99) {
+        error(res, line, label + ": phase " + std::to_string(ch.phs) + "% out of range (-99 - +99)");
+        return;
+    }
+
+    quantized_t q = quantize(ch.frq, ch.dty, ch.phs);
+    double want_frq = ch.frq / 10.0;
+
+    if (std::fabs(q.frq - want_frq) / want_frq * 100 > tolerance) {
+        warning(res, line, label + ": " + fmt(want_frq) + " Hz quantized to " + fmt(q.frq) +
+                " Hz (" + std::to_string(q.cycles_total) + " cycles per period)");
+    }
+
+    if (std::fabs(q.dty - ch.dty) > tolerance) {
+        warning(res, line, label + ": " + std::to_string(ch.dty) + "% duty cycle quantized to " +
+                fmt(q.dty) + "% (" + std::to_string(q.cycles_on) + " of " +
+                std::to_string(q.cycles_total) + " cycles)");
+    }
+
+    if (std::fabs(q.phs - ch.phs) > tolerance) {
+        warning(res, line, label + ": " + std::to_string(ch.phs) + "% phase quantized to " +
+                fmt(q.phs) + "%");
+    }
+
+    if (ch.dty == 0 || ch.dty == 100) {
+        warning(res, line, label + ": " + std::to_string(ch.dty) + "% duty cycle, '" +
+                (ch.dty ? "on" : "off") + "' mode does the same without interrupt load");
+    }
+}
+
+}  // namespace
+
+quantized_t quantize(uint32_t frq, uint32_t dty, int16_t phs) {
+    quantized_t q;
+
+    // Same clamping and integer math as set_pin_config()
+    if (frq > PWM_MAX_FRQ) frq = PWM_MAX_FRQ;
+    if (dty > 100) dty = 100;
+
+    q.cycles_total = PWM_TICKS_X10 / frq;
+    q.cycles_on = q.cycles_total * dty / 100U;
+
+    // Phase offset as applied by commit_pins()
+    int32_t offset = (int32_t)q.cycles_total * phs / 100;
+
+    q.frq = PWM_TICKS_X10 / 10.0 / q.cycles_total;
+    q.dty = 100.0 * q.cycles_on / q.cycles_total;
+    q.phs = 100.0 * offset / q.cycles_total;
+
+    return q;
+}
+
+void validate_pattern(result_t &res, double tolerance) {
+    pattern_t &pat = res.pattern;
+    std::map<std::string, int> names;
+
+    // Slots
+    if (pat.slots.size() > NUM_SLOTS) {
+        error(res, pat.slots[NUM_SLOTS].line, "too many slots, the device holds " +
+              std::to_string(NUM_SLOTS));
+    }
+
+    for (slot_def_t &slot : pat.slots) {
+        check_name(res, slot.line, slot.name, EE_SLOT_NAME_SIZE, "slot");
+
+        if (names.count(slot.name)) {
+            error(res, slot.line, "slot '" + slot.name + "' already defined on line " +
+                  std::to_string(names[slot.name]));
+        }
+        else names[slot.name] = slot.line;
+
+        std::map<std::string, int> channel_names;
+
+        for (int i = 0; i < NUM_PINS; i++) {
+            channel_t &ch = slot.channels[i];
+
+            // Same naming as the list menu when no slot is loaded
+            if (!ch.defined) {
+                ch.name = "PWM " + std::to_string(i + 1);
+                ch.line = slot.line;
+                continue;
+            }
+
+            validate_channel(res, ch, i, tolerance);
+
+            if (channel_names.count(ch.name)) {
+                warning(res, ch.line, "channel " + std::to_string(i) + " has the same name as channel " +
+                        std::to_string(channel_names[ch.name]));
+            }
+            else channel_names[ch.name] = i;
+        }
+    }
+
+    // Playlists
+    if (pat.playlists.size() > NUM_PLAYLISTS) {
+        error(res, pat.playlists[NUM_PLAYLISTS].line, "too many playlists, the device holds " +
+              std::to_string(NUM_PLAYLISTS));
+    }
+
+    for (playlist_def_t &pl : pat.playlists) {
+        check_name(res, pl.line, pl.name, EE_PLAYLIST_NAME_SIZE, "playlist");
+
+        if (pl.steps.empty()) warning(res, pl.line, "playlist '" + pl.name + "' has no steps");
+
+        if (pl.steps.size() > PL_MAX_STEPS) {
+            error(res, pl.steps[PL_MAX_STEPS].line, "too many steps, playlists hold " +
+                  std::to_string(PL_MAX_STEPS));
+        }
+
+        for (step_def_t &step : pl.steps) {
+            step.slot_idx = resolve_slot(pat, step.slot);
+
+            if (step.slot_idx == -1) error(res, step.line, "unknown slot '" + step.slot + "'");
+
+            if (step.dwell < 1) error(res, step.line, "dwell time must be at least 0.1 s");
+            else if (step.dwell > UINT16_MAX) {
+                error(res, step.line, "dwell time above the " + fmt(UINT16_MAX / 10.0) + " s limit");
+            }
+
+            if (step.fade > step.dwell) error(res, step.line, "fade time longer than the dwell time");
+        }
+    }
+
+    // Default slot
+    if (!pat.default_slot.empty()) {
+        pat.default_idx = resolve_slot(pat, pat.default_slot);
+
+        if (pat.default_idx == -1) error(res, pat.default_line, "unknown slot '" + pat.default_slot + "'");
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <cobs.h> @endcode
+ *
+ * @brief Consistent Overhead Byte Stuffing
+ * @details Removes every zero from a block of data, so a single
+ * zero can mark the end of a frame. Blocks of up to 254 bytes
+ * grow by exactly one byte
+ */
+
+#ifndef COBS_H
+#define COBS_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/**
+ * @brief Encodes a block of data
+ * 
+ * @param[in] src Data to encode (up to 254 bytes)
+ * @param[in] len Length of the data
+ * @param[out] dest Encoded data, must hold len + 1 bytes. Can't
+ * overlap with src
+ * @return uint8_t Length of the encoded data
+ */
+uint8_t cobs_encode(const uint8_t *src, uint8_t len, uint8_t *dest);
+
+/**
+ * @brief Decodes a block of data, without the trailing zero
+ * 
+ * @param[in] src Encoded data
+ * @param[in] len Length of the encoded data
+ * @param[out] dest Decoded data, must hold len bytes. Can be the
+ * same buffer as src
+ * @return int16_t Length of the decoded data, -1 if the data
+ * isn't valid COBS
+ */
+int16_t cobs_decode(const uint8_t *src, uint8_t len, uint8_t *dest);
+
+/**
+ * @brief Decodes a single byte of a block, without decoding the
+ * rest. Only the encoded bytes up to it are needed
+ * 
+ * @param[in] src Encoded data, or its first bytes
+ * @param[in] len Length of the encoded data available
+ * @param[in] idx Position of the byte in the decoded data
+ * @return uint8_t The decoded byte, 0 if it isn't available
+ */
+uint8_t cobs_byte(const uint8_t *src, uint8_t len, uint8_t idx);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* COBS_H */
@@ -21,6 +21,8 @@
     // PWMs
 
     #define NUM_PINS 8
+    #define PWM_TICKS_X10 200000U // Interrupt cycles per second times ten
+    #define PWM_MAX_FRQ 4000U // Tenths of Hz
 
     #define PWM_PORT_0 PORTE
     #define PWM_PORT_CONF_0 DDRE
@@ -81,6 +83,14 @@
 
     #define EV_QUEUE_SIZE 32
 
+    #define LAT_TICK_US 4 // Timestamp resolution, Timer1 with a 64 prescaler
+    #define LAT_HIST_BINS 17 // One per bit of a 16-bit tick count, plus 0
+
+    //**************************//
+    // Scheduler
+
+    #define SCHED_WHEEL_SIZE 16  // Buckets, one per ms tick
+
     //**************************//
     // Memory
 
@@ -89,6 +99,26 @@
     #define EE_PWM_NAME_SIZE 20 // Including '\0'
     #define EE_SLOT_NAME_SIZE 12 // Including '\0'
     #define EE_PASS_SIZE 3
+    #define EE_MAX_COMPARES 16 // Unchanged bytes skipped per update call
+
+    //**************************//
+    // Playlists
+
+    #define NUM_PLAYLISTS 4
+    #define PL_MAX_STEPS 16
+
+    #define EE_PLAYLIST_NAME_SIZE 12 // Including '\0'
+
+    //**************************//
+    // Morphs
+
+    #define MORPH_DEFAULT_FRQ 1000 // Tenths of Hz, used to fade between OFF and ON
+    #define MORPH_STEP_TIME 10 // ms between intermediate values
+
+    //**************************//
+    // Batches
+
+    #define BATCH_TIMEOUT 5000 // ms an open batch waits for its commit
 
     //**************************//
     // Rotary encoder
@@ -101,10 +131,25 @@
     // Serial
 
     #define SER_BAUD 115200
-    #define SER_UBRR ((F_CPU / (SER_BAUD * 8UL)) - 1)  // UART clock is 8 instead of 16 due to double speed operation
+    #define SER_UBRR_OF(baud) ((F_CPU / ((baud) * 8UL)) - 1)  // UART clock is 8 instead of 16 due to double speed operation
+    #define SER_UBRR SER_UBRR_OF(SER_BAUD)
+    #define SER_FAST_BAUDS 500000, 1000000 // Offered to the host, exact at 16 MHz with double speed
+    #define SER_PROBE_TIME 1000 // ms for the host to confirm a new baud rate
+    #define SER_ERROR_CHECK 1000 // ms between link error checks at a fast baud rate
+    #define SER_MAX_ERRORS 4 // RX errors per check that send the link back to SER_BAUD
     #define SER_BUFS_SIZE 64
+    #define SER_TX_SIZE 128 // TX ring buffer, power of two up to 128
+    #define SER_RX_LINES 4 // RX line buffers, power of two
+    #define SER_MAX_FIELDS 8 // Fields split as they arrive, up to 8. Further commas are kept in the last one
     #define SER_START_CHAR '^'
     #define SER_END_CHAR '\n'
+    #define SER_TAG_CHAR '#' // ^#T,... requests are replied with ^#T,!,...
+    #define SER_TAG_SIZE 4 // Letters and digits in a tag
+
+    #define BIN_VERSION 1 // Binary protocol version, reported in the handshake
+    #define BIN_TIMEOUT 10000 // ms without a valid frame before going back to ASCII
+    #define BIN_WINDOW 8 // Frames the host may send ahead of the last ACK
+    #define TELEMETRY_MIN_PERIOD 20 // ms, shortest time between status frames
 
     //**************************//
     // General UI
@@ -113,6 +158,7 @@
     #define UI_BOOT_DELAY 3  // s
     
     #define LCD_NUM_CUSTOM_CHARS 8
+    #define LCD_FRAME_TIME 40 // ms, minimum time between redraws
 
     #define LCD_MIN_BRIGHTNESS 0
     #define LCD_MAX_BRIGHTNESS 100
@@ -120,17 +166,19 @@
     //**************************//
     // List menu
 
-    #define LST_NUM_ENTRIES 12
+    #define LST_NUM_ENTRIES 13
 
     #define LST_LOAD_INDEX 8
     #define LST_SAVE_INDEX 9
     #define LST_DELETE_INDEX 10
     #define LST_BRIGHTNESS_INDEX 11
+    #define LST_PLAY_INDEX 12
 
     //**************************//
     // Slow menu
 
     #define SLOW_NUM_ENTRIES 5
+    #define SLOW_STEP_TIME 500 // ms, sequences are written in half seconds
 
     #define SLOW_BL_INDEX 0
     #define SLOW_FL_INDEX 1
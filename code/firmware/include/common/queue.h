@@ -6,6 +6,11 @@
  * @code #include <array.h> @endcode
  *
  * @brief Very basic circular queue library
+ * @details Lock-free as long as there is a single producer and a
+ * single consumer. AVR interrupts don't nest, so every ISR
+ * pushing into the same queue counts as a single producer, and
+ * the main loop is the consumer. Every element carries a 16-bit
+ * timestamp along with its value
  */
 
 #ifndef QUEUE_H
@@ -20,13 +25,22 @@
 
 #include "config.h"
 
+#if (EV_QUEUE_SIZE & (EV_QUEUE_SIZE - 1)) != 0 || EV_QUEUE_SIZE > 128
+    #error "EV_QUEUE_SIZE must be a power of two, up to 128"
+#endif
+
 /**
  * @brief Definition of the queue type
+ * @details Pointers run freely and wrap around at 256, and are
+ * masked when indexing the buffer. Since the size divides 256,
+ * w_ptr - r_ptr is always the number of queued elements
  */
 typedef struct queue_t {
-    int buf[EV_QUEUE_SIZE]; /**< Queue buffer */
-    uint8_t r_ptr; /**< Read "pointer" */
-    uint8_t w_ptr; /**< Write "pointer" */
+    volatile uint8_t buf[EV_QUEUE_SIZE]; /**< Queue buffer */
+    volatile uint16_t time[EV_QUEUE_SIZE]; /**< Timestamp of each element */
+    volatile uint8_t r_ptr; /**< Read "pointer", only written by the consumer */
+    volatile uint8_t w_ptr; /**< Write "pointer", only written by the producer */
+    volatile uint8_t max_depth; /**< Highest number of queued elements so far */
 } queue_t;
 
 /**
@@ -47,25 +61,55 @@ bool queue_empty(queue_t *q);
  */
 bool queue_full(queue_t *q);
 
+/**
+ * @brief Gets the number of queued elements
+ * 
+ * @param[in,out] q Queue pointer
+ * @return uint8_t Number of elements
+ */
+uint8_t queue_depth(queue_t *q);
+
+/**
+ * @brief Gets the highest number of elements that have been
+ * queued at once (high-water mark)
+ * 
+ * @param[in,out] q Queue pointer
+ * @return uint8_t Number of elements
+ */
+uint8_t queue_max_depth(queue_t *q);
+
+/**
+ * @brief Reads the oldest element without taking it out of
+ * the queue
+ * 
+ * @param[in,out] q Queue pointer
+ * @param[out] data Oldest element
+ * @return true If there was an element
+ * @return false If the queue is empty
+ */
+bool queue_peek(queue_t *q, uint8_t *data);
+
 /**
  * @brief Pops element from the queue
  * 
  * @param[in,out] q Queue pointer
  * @param[out] data Element's value
+ * @param[out] time Element's timestamp, may be NULL
  * @return true Done successfully
  * @return false Error, queue is empty
  */
-bool queue_pop(queue_t *q, int *data);
+bool queue_pop(queue_t *q, uint8_t *data, uint16_t *time);
 
 /**
  * @brief Pushes an element into the queue
  * 
  * @param[in,out] q Queue pointer
  * @param[in] data New element's value
+ * @param[in] time New element's timestamp
  * @return true Done successfully
  * @return false Error, queue is full
  */
-bool queue_push(queue_t *q, int data);
+bool queue_push(queue_t *q, uint8_t data, uint16_t time);
 
 #ifdef __cplusplus
     }
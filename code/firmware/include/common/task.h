@@ -0,0 +1,95 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <task.h> @endcode
+ *
+ * @brief Very basic resumable tasks (protothreads)
+ * @details A task is a function that returns whenever it has to
+ * wait, and picks up right where it left off when called again.
+ * The resume point is kept in a task_t, and the body is turned
+ * into a switch on it, so local variables don't survive a yield:
+ * anything needed after one must be static. Yields can't be
+ * placed inside another switch
+ *
+ * @code
+ * task_state_t count(task_t *t) {
+ *     static uint8_t i;
+ * 
+ *     TASK_BEGIN(t);
+ * 
+ *     for (i = 0; i < 10; i++) {
+ *         do_something(i);
+ *         TASK_YIELD(t);
+ *     }
+ * 
+ *     TASK_END(t);
+ * }
+ * @endcode
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/**
+ * @brief Result of running a task step
+ */
+typedef enum task_state_t {
+    TASK_WAITING, /**< The task has yielded and must be called again */
+    TASK_DONE /**< The task has finished */
+} task_state_t;
+
+/**
+ * @brief Definition of the task type
+ */
+typedef struct task_t {
+    uint16_t line; /**< Resume point, 0 to start from the beginning */
+} task_t;
+
+/**
+ * @brief Function running a task until its next yield
+ */
+typedef task_state_t (*task_fn_t)(task_t *t);
+
+/**
+ * @brief Makes the task start from the beginning on its next call
+ */
+#define TASK_INIT(t) ((t)->line = 0)
+
+/**
+ * @brief Opens the body of a task
+ */
+#define TASK_BEGIN(t) switch ((t)->line) { case 0:
+
+/**
+ * @brief Returns, and resumes right after this point on the next call
+ */
+#define TASK_YIELD(t) \
+    do { (t)->line = __LINE__; return TASK_WAITING; case __LINE__:; } while (0)
+
+/**
+ * @brief Returns until a condition holds, checking it again on
+ * every call
+ */
+#define TASK_WAIT_UNTIL(t, cond) \
+    do { (t)->line = __LINE__; case __LINE__: if (!(cond)) return TASK_WAITING; } while (0)
+
+/**
+ * @brief Closes the body of a task. It starts from the beginning
+ * if called again
+ */
+#define TASK_END(t) } (t)->line = 0; return TASK_DONE
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* TASK_H */
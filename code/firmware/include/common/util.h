@@ -40,6 +40,19 @@ char *itos(int num, int len, char *buf);
  */
 int wrap(int num, int min, int max);
 
+/**
+ * @brief Wraps a number around a range as many times as needed
+ * (Eg. 5 + 3, 0, 5 will return 2). Meant for cursors and
+ * cyclic choices such as digits or modes, which may move several
+ * entries at once
+ * 
+ * @param[in] num Number to wrap
+ * @param[in] min Lower limit (included)
+ * @param[in] max Upper limit (included)
+ * @return int Wrapped number
+ */
+int wrap_around(int num, int min, int max);
+
 /**
  * @brief Same as the wrap function, but also detects when the
  * number has wrapped
@@ -83,6 +96,19 @@ int limit(int num, int min, int max);
  */
 int limit_hit(int num, int min, int max, bool *min_hit, bool *max_hit);
 
+/**
+ * @brief Moves a cursor through a list shown a few lines at a
+ * time, wrapping around its ends and scrolling the list so the
+ * cursor stays on screen
+ * 
+ * @param[in,out] first Index of the first entry on screen
+ * @param[in,out] line Line the cursor is on
+ * @param[in] dir Number of entries to move, negative moves up
+ * @param[in] num_entries Number of entries in the list
+ * @param[in] num_lines Number of lines on screen
+ */
+void scroll_window(uint8_t *first, uint8_t *line, int dir, int num_entries, int num_lines);
+
 /**
  * @brief Gets a number's "length" (number of chars needed to
  * represent it)
@@ -92,6 +118,17 @@ int limit_hit(int num, int min, int max, bool *min_hit, bool *max_hit);
  */
 int get_num_length(int num);
 
+/**
+ * @brief Converts an unsigned number to decimal without
+ * dividing, subtracting powers of ten instead
+ * 
+ * @param[in] num Number to convert
+ * @param[out] buf Output buffer (at least 6 chars)
+ * @return uint8_t Number of digits written, the buffer is also
+ * zero terminated
+ */
+uint8_t utos(uint16_t num, char *buf);
+
 
 #ifdef __cplusplus
     }
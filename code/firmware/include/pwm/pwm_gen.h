@@ -47,6 +47,12 @@ typedef struct pwm_pin_t {
     uint16_t frq; /**< Intended frequency for the pin */
     uint16_t dty; /**< Intended duty cycle for the pin */
     int16_t phs; /**< Intended phase for the pin */
+
+    volatile uint32_t next_on; /**< cycles_on to be applied at the next period boundary */
+    volatile uint32_t next_total; /**< cycles_total to be applied at the next period boundary */
+    volatile uint32_t next_cnt; /**< Counter value the next period starts at */
+    volatile bool pending; /**< Whether the next_ values are waiting to be applied */
+    volatile uint32_t apply_tick; /**< Interrupt cycle in which the last pending change was applied */
 } pwm_pin_t;
 
 /**
@@ -68,12 +74,86 @@ void start_clock();
  */
 void stop_clock();
 
+/**
+ * @brief Checks whether the clock is running
+ * 
+ * @return true If the timer interrupt is enabled
+ * @return false If the timer interrupt is disabled
+ */
+bool clock_running();
+
+/**
+ * @brief Hands a full set of pin configurations over to the
+ * interrupt, which will swap it in at the start of its next
+ * cycle
+ * @details Only the fields used by @ref pwm_cycle are copied
+ * (mode, cycles and counter), so every pin changes on the very
+ * same tick without stopping the clock
+ * 
+ * @param[in] staged Vector containing the new PWM structures.
+ * Must stay untouched until @ref pins_staged returns false
+ */
+void stage_pins(pwm_pin_t *staged);
+
+/**
+ * @brief Checks whether a staged configuration is still waiting
+ * to be applied
+ * 
+ * @return true If the interrupt hasn't picked it up yet
+ * @return false If there is nothing pending
+ */
+bool pins_staged();
+
+/**
+ * @brief Gets the time in which the interrupt last applied a
+ * staged configuration or a pending change
+ * 
+ * @return uint16_t Timer1 timestamp, see @ref event_now
+ */
+uint16_t pins_apply_time();
+
+/**
+ * @brief Gets the number of interrupt cycles run since boot
+ * 
+ * @return uint32_t Interrupt cycles, about 50 us each
+ */
+uint32_t pwm_ticks();
+
+/**
+ * @brief Gets the interrupt cycle in which a pin's last pending
+ * change was applied
+ * 
+ * @param[in] pins Vector containing the PWM structures
+ * @param[in] pin Index of the pin
+ * @return uint32_t Interrupt cycle, see @ref pwm_ticks
+ */
+uint32_t pin_apply_tick(pwm_pin_t *pins, uint8_t pin);
+
+/**
+ * @brief Gets the share of time spent in the interrupt since the
+ * last call and starts a new measuring window
+ * @details Every cycle adds how far Timer2 has counted when it
+ * ends, so the interrupt's entry and exit aren't included. Windows
+ * longer than about 37 minutes read as 0
+ * 
+ * @return uint8_t Interrupt load (%)
+ */
+uint8_t pwm_load();
+
+/**
+ * @brief Same as pwm_load, but leaves the measuring window running
+ * 
+ * @return uint8_t Interrupt load since the last pwm_load (%)
+ */
+uint8_t pwm_load_peek();
+
 /**
  * @brief To be called on each interrupt cycle, handles setting
  * PWMs ON and OFF
  * @details Goes through the PWM pins vector and checks if the
  * number of cycles passed is equal to the max time on the PWM
- * or the repeat cycle
+ * or the repeat cycle. Pending per-pin changes are applied
+ * when their period is over
  * @param[in] pwm_pins Vector containing all the PWM structures
  */
 void pwm_cycle(pwm_pin_t *pwm_pins);
@@ -37,7 +37,8 @@ void set_pin_mode(pwm_pin_t *pins, uint8_t pin, pin_mode mode);
  * 
  * @param[in,out] pins Vector containing the PWM pins
  * @param[in] pin Pin to be modified
- * @param[in] frq Frequency (Hz) to be set (0 - 400 Hz)
+ * @param[in] frq Frequency in tenths of Hz to be set (0 -
+ * PWM_MAX_FRQ, 0 is taken as 1)
  * @param[in] dty Duty cycle (%) to be set (0 - 100)
  */
 void set_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty);
@@ -55,6 +56,51 @@ void set_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty);
  */
 void set_pin_phase(pwm_pin_t *pins, uint8_t pin, int16_t phs);
 
+/**
+ * @brief Changes a pin's frequency, duty cycle and phase when
+ * its current period is over, instead of right away
+ * @details Uses the same math as @ref set_pin_config and
+ * @ref set_pin_phase. The phase is applied as a shift relative
+ * to the pin's current phase. Does nothing if the previous
+ * change hasn't been applied yet
+ * 
+ * @param[in,out] pins Vector containing the PWM pins
+ * @param[in] pin Pin to be modified
+ * @param[in] frq Frequency in tenths of Hz to be set (0 -
+ * PWM_MAX_FRQ, 0 is taken as 1)
+ * @param[in] dty Duty cycle (%) to be set (0 - 100)
+ * @param[in] phs Phase (%) to be set (-99 - +99)
+ * @return true If the change has been queued
+ * @return false If the pin still has a change pending
+ */
+bool queue_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty, int16_t phs);
+
+/**
+ * @brief Checks channel values received from the host against
+ * what the outputs can do
+ * @details OFF and ON channels don't use their frequency, and
+ * slots saved from the menus may hold 0 for them, so it's only
+ * required to be at least 1 in PWM mode
+ * 
+ * @param[in] mode See @ref pin_mode
+ * @param[in] frq Frequency in tenths of Hz (up to PWM_MAX_FRQ)
+ * @param[in] dty Duty cycle (%) (0 - 100)
+ * @param[in] phs Phase (%) (-99 - +99)
+ * @return true If every value is within range
+ * @return false Otherwise
+ */
+bool pin_values_valid(uint8_t mode, uint16_t frq, uint16_t dty, int16_t phs);
+
+/**
+ * @brief Checks whether any change is still waiting for the
+ * interrupt to apply it, either staged or pending
+ * 
+ * @param[in] pins Vector containing the PWM structures
+ * @return true If some change hasn't reached the outputs yet
+ * @return false Otherwise
+ */
+bool pins_pending(pwm_pin_t *pins);
+
 /**
  * @brief Intializes every pin
  * @note Implementation needs to be modified if more than 8 pins
@@ -74,6 +120,28 @@ void pins_init(pwm_pin_t *pins);
  */
 void sync_pwms(pwm_pin_t *pins);
 
+/**
+ * @brief Atomically replaces every pin's configuration
+ * @details The new configuration is prepared on a copy of the
+ * pins (see @ref copy_pins), phases are synced as @ref sync_pwms
+ * would, and the timer interrupt swaps it in on a single tick.
+ * Unlike @ref sync_pwms, the clock is never stopped
+ * 
+ * @param[in,out] pins PWM pins structure
+ * @param[in,out] staged Copy of the pins holding the new
+ * configuration
+ */
+void commit_pins(pwm_pin_t *pins, pwm_pin_t *staged);
+
+/**
+ * @brief Copies the pins structure, so it can be modified and
+ * later applied with @ref commit_pins
+ * 
+ * @param[in] pins PWM pins structure
+ * @param[out] dest Copy of the pins
+ */
+void copy_pins(pwm_pin_t *pins, pwm_pin_t *dest);
+
 /**
  * @brief Sets the GPIO configuration register to be either
  * input or output
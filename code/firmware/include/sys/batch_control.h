@@ -0,0 +1,85 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <batch_control.h> @endcode
+ * 
+ * @brief Configuration changes applied together
+ * @details Changes made while a batch is open are only recorded.
+ * On commit, every channel is replaced at the same interrupt
+ * cycle, so all of them start a new period together, and the
+ * settings are marked for the EEPROM in one go. A batch that
+ * isn't committed within BATCH_TIMEOUT is discarded
+ */
+
+#ifndef BATCH_CONTROL_H
+#define BATCH_CONTROL_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/**
+ * @brief Opens a batch, discarding the one already open
+ */
+void batch_begin();
+
+/**
+ * @brief Applies every change in the open batch and closes it
+ * @details Stops any running morph or playlist if a channel
+ * changes, since they would overwrite it on their next step
+ * 
+ * @return uint8_t Number of changes applied, 0 if no batch was
+ * open
+ */
+uint8_t batch_commit();
+
+/**
+ * @brief Discards the open batch, if any
+ */
+void batch_abort();
+
+/**
+ * @brief Checks whether a batch is open
+ * 
+ * @return true If changes are being recorded
+ * @return false Otherwise
+ */
+bool batch_active();
+
+/**
+ * @brief Records a channel change. A later change to the same
+ * channel replaces it
+ * 
+ * @param[in] pin Channel
+ * @param[in] mode Channel mode (OFF, PWM, ON)
+ * @param[in] frq Frequency, in tenths of Hz. 0 is taken as 1
+ * @param[in] dty Duty cycle
+ * @param[in] phs Phase
+ */
+void batch_set_pin(uint8_t pin, uint8_t mode, uint16_t frq, uint16_t dty, int16_t phs);
+
+/**
+ * @brief Records a new default slot
+ * 
+ * @param[in] slot Slot to be loaded on startup, -1 for none
+ */
+void batch_set_default_slot(int8_t slot);
+
+/**
+ * @brief Records a new screen brightness
+ * 
+ * @param[in] value Brightness, from LCD_MIN_BRIGHTNESS to
+ * LCD_MAX_BRIGHTNESS
+ */
+void batch_set_brightness(uint8_t value);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* BATCH_CONTROL_H */
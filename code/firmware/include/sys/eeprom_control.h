@@ -44,6 +44,25 @@ typedef struct slot_t {
     pwm_t pwms[NUM_PINS]; /**< The slot's 8 PWMs */
 } slot_t;
 
+/**
+ * @brief Single step of a playlist
+ */
+typedef struct step_t {
+    uint8_t slot; /**< Slot to be loaded (LIST MENU ORDER) */
+    uint16_t dwell; /**< Time the slot stays active, in tenths of a second */
+    uint16_t fade; /**< Time spent morphing into the slot, in tenths of a second (0 to switch at once) */
+} step_t;
+
+/**
+ * @brief Ordered list of slots to be stepped through
+ */
+typedef struct playlist_t {
+    char name[EE_PLAYLIST_NAME_SIZE]; /**< Playlist name */
+    uint8_t num_steps; /**< Number of steps, 0 if the playlist is unused */
+
+    step_t steps[PL_MAX_STEPS]; /**< The playlist's steps */
+} playlist_t;
+
 /**
  * @brief EEPROM memory structure
  */
@@ -57,6 +76,8 @@ typedef struct eeprom_t {
 
     slot_t slots[NUM_SLOTS]; /**< Memory slots */
     array_t used_slots; /**< Vector containing the indices of used slots */
+
+    playlist_t playlists[NUM_PLAYLISTS]; /**< Stored playlists */
 } eeprom_t;
 
 /**
@@ -69,6 +90,98 @@ typedef struct eeprom_t {
  */
 void eeprom_setup(pwm_pin_t *pins);
 
+/**
+ * @brief Writes pending changes to the EEPROM, a byte at a time
+ * @details Setters only change the RAM copy and mark the changed
+ * range. Each call writes at most one byte, and only if the
+ * previous write is over, so it never waits for the EEPROM.
+ * Bytes that haven't changed are skipped without writing. Meant
+ * to be called on every loop pass
+ */
+void eeprom_update();
+
+/**
+ * @brief Checks whether there are changes waiting to be written
+ * 
+ * @return true If there are pending changes
+ * @return false If the EEPROM matches the RAM copy
+ */
+bool eeprom_pending();
+
+/**
+ * @brief Copies part of the memory image, as the RAM copy holds
+ * it (changes not written yet included)
+ * 
+ * @param[in] offset First byte, from the start of eeprom_t
+ * @param[out] dest Where the bytes will be copied
+ * @param[in] len Number of bytes
+ */
+void eeprom_read_image(uint16_t offset, void *dest, uint8_t len);
+
+/**
+ * @brief Gets the CRC-16/CCITT (initial value 0xFFFF) of the
+ * whole memory image
+ * 
+ * @return uint16_t CRC of the RAM copy
+ */
+uint16_t eeprom_image_crc();
+
+/**
+ * @brief Starts replacing the whole memory image. It's received
+ * into the RAM copy, and nothing is written to the EEPROM until
+ * @ref eeprom_restore_end
+ * @details Until then the library reads as empty (no slots, no
+ * playlist steps, no default slot), the serial number, password
+ * and brightness are read from the EEPROM, and every eeprom_set_
+ * function, as well as new, overwrite and delete, is ignored.
+ * Callers should stop whatever plays the library back before
+ * starting
+ * 
+ * @return true If the restore has started
+ * @return false If previous changes are still being written
+ */
+bool eeprom_restore_begin();
+
+/**
+ * @brief Checks whether an image is being restored
+ * 
+ * @return true Between @ref eeprom_restore_begin and
+ * @ref eeprom_restore_end or @ref eeprom_restore_abort
+ * @return false Otherwise
+ */
+bool eeprom_restoring();
+
+/**
+ * @brief Receives part of the image being restored
+ * 
+ * @param[in] offset First byte, from the start of eeprom_t
+ * @param[in] data Image bytes
+ * @param[in] len Number of bytes, offset + len up to
+ * sizeof(eeprom_t)
+ */
+void eeprom_restore_chunk(uint16_t offset, const void *data, uint8_t len);
+
+/**
+ * @brief Finishes restoring an image
+ * @details If the image matches the CRC and holds a valid
+ * library (every used slot listed once and marked as used, and
+ * its channels within the outputs' limits), it's written in the background, skipping the bytes
+ * that haven't changed. The device keeps its own serial number.
+ * Otherwise the previous contents are read back from the EEPROM
+ * 
+ * @param[in] crc CRC-16/CCITT (initial value 0xFFFF) of the
+ * whole image
+ * @return true If the image has been accepted
+ * @return false If it has been dropped
+ */
+bool eeprom_restore_end(uint16_t crc);
+
+/**
+ * @brief Drops the image being restored, if any, and reads the
+ * previous contents back from the EEPROM
+ */
+void eeprom_restore_abort();
+
 /**
  * @brief Gets the initialization value
  * 
@@ -123,6 +236,36 @@ uint8_t eeprom_get_brightness();
 slot_t *eeprom_get_slot(uint8_t ui_idx, slot_t *dest);
 char *eeprom_get_slot_name(uint8_t ui_idx, char *dest);
 
+/**
+ * @brief Gets the content hash of a given slot
+ * @details CRC-16/CCITT (initial value 0xFFFF) of the slot name
+ * and then, for every PWM, its name, mode, frequency, duty cycle
+ * and phase. Names are hashed up to and including their
+ * terminator, numbers as little endian. Kept up to date as slots
+ * are written, so it's cheap to ask for
+ * 
+ * @param[in] ui_idx Index of the slot (LIST MENU ORDER)
+ * @return uint16_t Slot hash
+ */
+uint16_t eeprom_get_slot_crc(uint8_t ui_idx);
+
+/**
+ * @brief Gets a given playlist
+ * 
+ * @param[in] idx Index of the playlist
+ * @param[out] dest Returned playlist
+ * @return playlist_t* Pointer to the returned playlist
+ */
+playlist_t *eeprom_get_playlist(uint8_t idx, playlist_t *dest);
+
+/**
+ * @brief Gets the number of steps of a given playlist
+ * 
+ * @param[in] idx Index of the playlist
+ * @return uint8_t Number of steps, 0 if the playlist is unused
+ */
+uint8_t eeprom_get_playlist_steps(uint8_t idx);
+
 /**
  * @brief Sets the devices serial number
  * 
@@ -182,6 +325,14 @@ void eeprom_delete_slot(uint8_t ui_idx);
  */
 void eeprom_delete_all_slots();
 
+/**
+ * @brief Deletes the last slots, so that only a given number is
+ * left
+ * 
+ * @param[in] num_slots Number of slots to keep
+ */
+void eeprom_truncate_slots(uint8_t num_slots);
+
 /**
  * @brief Sets the configuration of a given signal from a given
  * slot
@@ -192,6 +343,14 @@ void eeprom_delete_all_slots();
  */
 void eeprom_set_pwm(uint8_t ui_idx, uint8_t pwm_idx, pwm_t *pwm);
 
+/**
+ * @brief Stores a playlist
+ * 
+ * @param[in] idx Index of the playlist
+ * @param[in] playlist Playlist to be stored
+ */
+void eeprom_set_playlist(uint8_t idx, playlist_t *playlist);
+
 /**
  * @brief Prints a given PWM to the serial port
  * @see serial_control.h
@@ -20,16 +20,144 @@
 
 /**
  * @brief Defines the different kinds of event
+ * @details Stored as single bytes in the event queue
  */
 typedef enum event_t {
     EV_NONE, /**< Null */
-    EV_ROT_L = -1, /**< Left rotary encoder rotation */
-    EV_ROT_R = 1, /**< Right rotary encoder rotation */
+    EV_ROT_L, /**< Left rotary encoder rotation */
+    EV_ROT_R, /**< Right rotary encoder rotation */
     EV_ROT_P, /**< Push button */
     EV_ROT_H, /**< Button hold */
-    EV_SERIAL /**< Serial message ready to be parsed */
+    EV_SERIAL, /**< Serial message ready to be parsed */
+    EV_COUNT /**< Number of event types, not an event */
 } event_t;
 
+/**
+ * @brief Latency histograms. Events use index event - 1, then
+ * come serial commands reaching the outputs and the formatting
+ * of slot dump lines
+ */
+#define LAT_HIST_EFFECT (EV_COUNT - 1)
+#define LAT_HIST_FORMAT EV_COUNT
+#define LAT_NUM_HISTS (EV_COUNT + 1)
+
+/**
+ * @brief Sets up the latency instrumentation
+ * @details Timer1 runs freely as the timestamp counter, one tick
+ * every LAT_TICK_US. With DEBUG_LATENCY defined, pin 12 (PB6)
+ * goes high when an event is queued and low when the main loop
+ * empties the queue, so the latency can be seen with a scope
+ */
+void event_setup();
+
+/**
+ * @brief Gets the current timestamp
+ * 
+ * @return uint16_t Timer1 ticks, wraps every 262 ms
+ */
+uint16_t event_now();
+
+/**
+ * @brief Gets the time in which the event being handled was
+ * queued
+ * 
+ * @return uint16_t Timestamp
+ */
+uint16_t event_get_time();
+
+/**
+ * @brief Adds a latency to one of the histograms
+ * 
+ * @param[in] hist Histogram index
+ * @param[in] ticks Latency, in timestamp ticks
+ */
+void event_record_latency(uint8_t hist, uint16_t ticks);
+
+/**
+ * @brief Gets a histogram bin. Bin 0 counts latencies of 0
+ * ticks, and bin i counts those from 2^(i - 1) to 2^i - 1 ticks
+ * 
+ * @param[in] hist Histogram index
+ * @param[in] bin Bin index
+ * @return uint16_t Count (saturates)
+ */
+uint16_t event_get_histogram(uint8_t hist, uint8_t bin);
+
+/**
+ * @brief Empties every histogram and resets the maximum latency
+ */
+void event_clear_histograms();
+
+/**
+ * @brief Queues an event, counting it as dropped if the queue is
+ * full. Meant to be called from interrupts
+ * 
+ * @param[in] ev Event to queue
+ * @return true If the event has been queued
+ * @return false If the queue is full
+ */
+bool event_push(event_t ev);
+
+/**
+ * @brief Takes the oldest event out of the queue
+ * 
+ * @param[out] ev Event
+ * @return true If there was an event
+ * @return false If the queue is empty
+ */
+bool event_pop(event_t *ev);
+
+/**
+ * @brief Gets the number of events of a given type that have
+ * been dropped because the queue was full
+ * 
+ * @param[in] ev Event type
+ * @return uint16_t Number of dropped events (saturates)
+ */
+uint16_t event_get_dropped(event_t ev);
+
+/**
+ * @brief Gets the highest time an event has waited in the queue
+ * before the main loop took it out
+ * 
+ * @return uint16_t Latency in microseconds (saturates)
+ */
+uint16_t event_get_max_latency();
+
+/**
+ * @brief Marks the start of a main loop pass
+ */
+void event_pass_start();
+
+/**
+ * @brief Marks the end of a main loop pass, keeping track of the
+ * longest one. Nothing in the loop can react to the user for
+ * that long, so it's the worst-case UI stall
+ */
+void event_pass_end();
+
+/**
+ * @brief Gets the longest main loop pass so far
+ * 
+ * @return uint16_t Duration in microseconds (saturates)
+ */
+uint16_t event_get_max_stall();
+
+/**
+ * @brief Gets the number of queued events
+ * 
+ * @return uint8_t Number of events
+ */
+uint8_t event_get_depth();
+
+/**
+ * @brief Gets the highest number of events that have been
+ * queued at once
+ * 
+ * @return uint8_t Number of events
+ */
+uint8_t event_get_max_depth();
+
 /**
  * @brief Handles the different types of event
  * @see event_t
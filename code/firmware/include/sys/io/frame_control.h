@@ -0,0 +1,146 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <frame_control.h> @endcode
+ *
+ * @brief Binary serial protocol
+ * @details Negotiated from the ASCII protocol with ^?,b. Every
+ * message is a frame made of a type, a sequence number, a payload
+ * and a CRC-16/CCITT (initial value 0xFFFF, little endian) of the
+ * previous bytes. Frames are COBS encoded and end with a zero, so
+ * they fit in the same buffers as ASCII lines. Replies carry the
+ * sequence number of the request. Payloads are the firmware's own
+ * structures, little endian and without padding
+ *
+ * Bulk uploads are acknowledged frame by frame, so the host can
+ * keep up to BIN_WINDOW frames in flight. Upload frames must
+ * arrive in sequence: the first one out of order is rejected with
+ * NAK_SEQ and the expected number, and the host goes back to it.
+ * Frames already applied are acknowledged again but not reapplied
+ *
+ * FR_GET_IMAGE dumps the whole EEPROM image (eeprom_t) in chunks,
+ * followed by its CRC. An image is restored the same way, as an
+ * upload of FR_IMAGE_SIZE, FR_IMAGE_DATA and FR_IMAGE_CRC frames.
+ * It's only applied if the CRC matches, and then only the bytes
+ * that changed are written. Playback stops when it starts, and
+ * until it's over frames that read the library or change the
+ * outputs get NAK_BUSY
+ *
+ * FR_ACTIVATE puts a stored slot on the outputs or starts a slow
+ * sequence, the same way the menus do, and replies with the
+ * resulting live state
+ *
+ * FR_LIVE changes a running output without touching the stored
+ * slots. PWM changes wait for the end of the pin's current period,
+ * and FR_LIVE_DONE reports the interrupt cycle they took effect in
+ */
+
+#ifndef FRAME_CONTROL_H
+#define FRAME_CONTROL_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#include "common/config.h"
+
+// Type, sequence number and CRC around the payload, plus the
+// COBS overhead, must fit in a line buffer
+#define FRAME_MAX_DATA (SER_BUFS_SIZE - 5)
+#define FRAME_MAX_SIZE (SER_BUFS_SIZE + 1)  // Encoded, with the trailing zero
+
+/**
+ * @brief Frame types. Replies have the highest bit set
+ */
+typedef enum frame_type_t {
+    FR_PING = 0x01,  /**< Keeps the link alive. Replied with FR_PONG */
+    FR_GET_INFO = 0x02,  /**< Replied with FR_INFO */
+    FR_GET_SLOTS = 0x03,  /**< Replied with FR_SLOT_COUNT, then FR_SLOT and FR_PWM for every slot */
+    FR_SLOT_COUNT = 0x04,  /**< Number of slots (uint8_t), starts a bulk upload */
+    FR_SLOT = 0x05,  /**< Slot index (uint8_t) and name */
+    FR_PWM = 0x06,  /**< Slot index (uint8_t), PWM index (uint8_t) and pwm_t */
+    FR_GET_HASHES = 0x07,  /**< Replied with FR_HASHES */
+    FR_GET_SLOT = 0x08,  /**< Slot index (uint8_t). Replied with FR_SLOT and FR_PWM for that slot */
+    FR_SYNC_COUNT = 0x09,  /**< Number of slots (uint8_t), starts a partial upload */
+    FR_LIVE = 0x0A,  /**< Pin (uint8_t), mode (uint8_t), frequency in tenths of Hz, duty cycle (uint16_t) and phase (int16_t) */
+    FR_TELEMETRY = 0x0B,  /**< Period in ms (uint16_t), 0 to stop. Replied with FR_STATUS every period */
+    FR_GET_LINK = 0x0C,  /**< Optionally, 1 (uint8_t) to clear the counters once read. Replied with FR_LINK */
+    FR_GET_IMAGE = 0x0D,  /**< Replied with FR_IMAGE_SIZE, then FR_IMAGE_DATA for the whole image and FR_IMAGE_CRC */
+    FR_IMAGE_SIZE = 0x0E,  /**< Image size (uint16_t), must be sizeof(eeprom_t). Starts an image restore */
+    FR_ASCII = 0x0F,  /**< Goes back to the ASCII protocol after the FR_PONG */
+    FR_IMAGE_DATA = 0x10,  /**< Offset (uint16_t) and image bytes, in order and without gaps */
+    FR_IMAGE_CRC = 0x11,  /**< CRC of the whole image (uint16_t), same as frames. Ends an image restore, NAK_FORMAT if the image is dropped */
+    FR_ACTIVATE = 0x12,  /**< Target (uint8_t, 0 for a slot, 1 for a slow sequence) and index (int8_t, -1 for none). Replied with FR_STATUS once applied */
+    FR_GET_STATUS = 0x13,  /**< Replied with FR_STATUS */
+
+    FR_PONG = 0x81,  /**< Protocol version (uint8_t) */
+    FR_INFO = 0x82,  /**< Serial (uint16_t), default slot (int8_t), maximum and used slots (uint8_t) */
+    FR_HASHES = 0x87,  /**< Number of slots (uint8_t) and their hashes (uint16_t) */
+    FR_LIVE_DONE = 0x8A,  /**< Pin (uint8_t) and interrupt cycle (uint32_t) in which the FR_LIVE took effect */
+    FR_STATUS = 0x8B,  /**< status_t, see telemetry_control.h */
+    FR_LINK = 0x8C,  /**< Link quality counters (uint16_t), in link_counter_t order, see serial_control.h */
+    FR_REPLY = 0x80,  /**< Added to FR_SLOT_COUNT, FR_SLOT, FR_PWM and the FR_IMAGE_ types when sent by the device */
+    FR_ACK = 0xFE,  /**< Every upload frame up to this sequence number has been applied */
+    FR_NAK = 0xFF  /**< Reason (frame_nak_t), plus the expected sequence number for NAK_SEQ */
+} frame_type_t;
+
+/**
+ * @brief Reasons for a frame to be rejected
+ */
+typedef enum frame_nak_t {
+    NAK_CRC = 1,  /**< Wrong CRC or COBS encoding */
+    NAK_FORMAT = 2,  /**< Wrong payload length or values */
+    NAK_TYPE = 3,  /**< Unknown frame type */
+    NAK_BUSY = 4,  /**< Frame dropped, a long reply is being sent, the pin has a change pending or an image is being restored */
+    NAK_SEQ = 5  /**< Upload frame out of sequence */
+} frame_nak_t;
+
+/**
+ * @brief Switches to the binary protocol. Goes back to ASCII
+ * after BIN_TIMEOUT milliseconds without a valid frame
+ */
+void frame_begin();
+
+/**
+ * @brief Sends the confirmations of live changes that have
+ * reached the outputs. Meant to be called on every loop pass
+ */
+void frame_update();
+
+/**
+ * @brief Decodes and handles a received frame
+ *
+ * @param[in,out] buf COBS encoded frame, without the trailing
+ * zero. Decoded in place
+ * @param[in] len Length of the encoded frame
+ */
+void frame_process(uint8_t *buf, uint8_t len);
+
+/**
+ * @brief Sends a frame
+ *
+ * @param[in] type Frame type
+ * @param[in] seq Sequence number
+ * @param[in] data Payload
+ * @param[in] len Length of the payload, up to FRAME_MAX_DATA
+ */
+void frame_send(uint8_t type, uint8_t seq, const void *data, uint8_t len);
+
+/**
+ * @brief Rejects a frame
+ *
+ * @param[in] seq Sequence number of the rejected frame
+ * @param[in] reason Why it was rejected
+ */
+void frame_nak(uint8_t seq, frame_nak_t reason);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* FRAME_CONTROL_H */
@@ -18,6 +18,28 @@
     extern "C" {
 #endif
 
+#include "common/task.h"
+#include "sys/eeprom_control.h"
+
+/**
+ * @brief Link quality counters, queried with ^?,q and cleared
+ * with ^!,q
+ */
+typedef enum link_counter_t {
+    LINK_FRAMING,  /**< Bytes received with a framing error */
+    LINK_OVERRUN,  /**< Bytes lost because the previous one wasn't read in time */
+    LINK_PARITY,  /**< Bytes received with a parity error */
+    LINK_DROPPED,  /**< Lines and frames dropped, every buffer was busy */
+    LINK_TRUNCATED,  /**< ASCII lines longer than a buffer */
+    LINK_ERR1,  /**< Lines replied with ^!,ERR1 */
+    LINK_ERR2,  /**< Lines replied with ^!,ERR2 */
+    LINK_ERR3,  /**< Lines replied with ^!,ERR3 */
+    LINK_ERR4,  /**< Lines replied with ^!,ERR4 */
+    LINK_ERR5,  /**< Lines replied with ^!,ERR5 */
+    LINK_CRC,  /**< Frames with a wrong CRC or COBS encoding */
+    LINK_COUNT
+} link_counter_t;
+
 /**
  * @brief Sets up serial communication
  * @details Sets the baud rate to 115200 by enabling double
@@ -53,8 +75,39 @@ bool serial_rx_available();
  */
 bool serial_tx_available();
 
+/**
+ * @brief Queues a byte for sending, without waiting
+ * 
+ * @param data Byte to be written
+ * @return true If the byte has been queued
+ * @return false If the TX buffer is full
+ */
+bool serial_put_c(char data);
+
+/**
+ * @brief Gets the free space in the TX buffer
+ * 
+ * @return uint8_t Number of bytes that can be queued without
+ * waiting
+ */
+uint8_t serial_tx_free();
+
+/**
+ * @brief Waits until every queued byte has been sent, including
+ * the last one's stop bit
+ */
+void serial_flush();
+
+/**
+ * @brief Sends the next queued byte. Meant to be called from
+ * the UDRE interrupt, which is disabled once the buffer is empty
+ */
+void serial_tx_next();
+
 /**
  * @brief Sends a byte through the serial port
+ * @details Bytes are queued in a ring buffer and sent from the
+ * UDRE interrupt, so this only waits if the buffer is full
  * 
  * @param data Byte to be written
  */
@@ -98,15 +151,162 @@ void serial_writeln_s(char *data);
 void serial_writeln_n(int data);
 
 /**
- * @brief Organizes valid serial input into a buffer
+ * @brief Organizes valid serial input into line buffers
+ * @details Lines are assembled in one of SER_RX_LINES buffers
+ * and handed over to @ref process_data when complete, so the
+ * host can send commands back to back. If every buffer is still
+ * waiting to be parsed, the line is dropped and the host gets a
+ * ^!,BUSY,C reply (C the dropped command), or NAK_BUSY with the
+ * dropped frame's sequence number. ASCII lines are split into fields and their numbers
+ * converted byte by byte, so they're ready to run once the newline
+ * arrives. A start char always begins a new line
+ * 
+ * @return true If a line has just been handed over
+ * @return false Otherwise
  */
 bool process_serial();
 
 /**
- * @brief Parses the serial buffer
+ * @brief Runs the oldest received line or frame, and frees its
+ * buffer. Lines with missing, malformed or out of range
+ * arguments, or longer than a buffer, are replied with ^!,ERR4.
+ * Commands that can't be batched while a batch is open, and
+ * channel changes outside one, are replied with ^!,ERR5
+ *
+ * Lines starting with ^#T, (T up to SER_TAG_SIZE letters and
+ * digits) are replied with ^#T,!,... and set commands with no
+ * reply of their own with ^#T,!,OK. Tagged queries are run even
+ * while a long reply is being sent, its lines and theirs can be
+ * told apart. Any other line gets BUSY until it's done
  */
 void process_data();
 
+/**
+ * @brief Switches between the ASCII and binary protocols
+ * @details In binary mode, received bytes are gathered until a
+ * zero into the same buffers as ASCII lines, and handed over to
+ * @ref frame_process. Bytes already queued for sending aren't
+ * affected
+ * 
+ * @param[in] binary True for the binary protocol
+ */
+void serial_set_binary(bool binary);
+
+/**
+ * @brief Checks which protocol is in use
+ * 
+ * @return true If in binary mode
+ * @return false If in ASCII mode
+ */
+bool serial_binary();
+
+/**
+ * @brief Confirms a new baud rate, when the host's probe arrives
+ * @details After switching to a fast baud rate, the device goes
+ * back to SER_BAUD unless a handshake arrives within
+ * SER_PROBE_TIME. Once confirmed, it still goes back if more than
+ * SER_MAX_ERRORS framing, overrun or parity errors show up in
+ * SER_ERROR_CHECK
+ */
+void serial_baud_confirm();
+
+/**
+ * @brief Starts sending a long reply, which is carried on by
+ * @ref serial_update
+ * 
+ * @param[in] fn Task sending the reply
+ * @return true If the task has been started
+ * @return false If another reply is still being sent
+ */
+bool serial_start_task(task_fn_t fn);
+
+/**
+ * @brief Checks whether a long reply is being sent
+ * 
+ * @return true If a task started with @ref serial_start_task
+ * hasn't finished yet
+ * @return false Otherwise
+ */
+bool serial_task_running();
+
+/**
+ * @brief Clears the library, before a bulk upload
+ * 
+ * @param[in] num_slots Number of slots about to be sent
+ */
+void upload_start(uint8_t num_slots);
+
+/**
+ * @brief Starts a partial upload, where only the slots that
+ * changed are sent. Slots past the new count are deleted, the
+ * rest are kept
+ * 
+ * @param[in] num_slots Number of slots the library will have
+ */
+void upload_sync(uint8_t num_slots);
+
+/**
+ * @brief Starts receiving a slot of an upload. Existing slots are
+ * overwritten, new ones must come in order
+ * 
+ * @param[in] idx Slot index
+ * @param[in] name Slot name
+ * @return true If the index is valid
+ * @return false Otherwise
+ */
+bool upload_slot(uint8_t idx, const char *name);
+
+/**
+ * @brief Receives a PWM of the current slot. The slot is stored
+ * as soon as its last PWM arrives
+ * 
+ * @param[in] slot Slot index, must be the one being received
+ * @param[in] pin PWM index
+ * @param[in] pwm PWM configuration
+ * @return true If the indices are valid
+ * @return false Otherwise
+ */
+bool upload_pwm(uint8_t slot, uint8_t pin, const pwm_t *pwm);
+
+/**
+ * @brief Takes back the line just handed over by
+ * @ref process_serial, and lets the host know the command has
+ * been dropped because the device is too busy to queue it, the
+ * same way as lines dropped by @ref process_serial. Safe to call
+ * from interrupts, the reply is sent by @ref serial_update
+ */
+void serial_reject();
+
+/**
+ * @brief Adds one to a link quality counter. Counters stop at
+ * UINT16_MAX. Safe to call from interrupts
+ * 
+ * @param[in] counter Counter to increase
+ */
+void serial_count(link_counter_t counter);
+
+/**
+ * @brief Gets a link quality counter
+ * 
+ * @param[in] counter Counter to read
+ * @return uint16_t Its value since boot or the last clear
+ */
+uint16_t serial_get_count(link_counter_t counter);
+
+/**
+ * @brief Sets every link quality counter back to zero
+ */
+void serial_clear_counts();
+
+/**
+ * @brief Sends any pending replies that couldn't be sent from
+ * an interrupt, and carries on with long replies (slot and
+ * playlist lists, histograms). Those only write a line when it
+ * fits in the TX buffer, so the UI keeps responding. Meant to be
+ * called on every loop pass
+ */
+void serial_update();
+
 #ifdef __cplusplus
     }
 #endif
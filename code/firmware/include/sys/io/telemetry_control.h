@@ -0,0 +1,84 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <telemetry_control.h> @endcode
+ *
+ * @brief Periodic status frames for the binary protocol
+ * @details Once subscribed with FR_TELEMETRY, the device sends an
+ * FR_STATUS frame with its live state every period. Frames that
+ * don't fit in the TX buffer when they're due are skipped and
+ * counted, so telemetry never makes the main loop wait
+ */
+
+#ifndef TELEMETRY_CONTROL_H
+#define TELEMETRY_CONTROL_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#include "common/config.h"
+
+/**
+ * @brief State of a single output, as sent in a status frame
+ */
+typedef struct status_pin_t {
+    uint16_t frq; /**< Frequency, in tenths of Hz */
+    uint8_t dty; /**< Duty cycle (%) */
+    int8_t phs; /**< Phase (%) */
+} status_pin_t;
+
+/**
+ * @brief Payload of a status frame. Little endian, no padding
+ */
+typedef struct status_t {
+    uint32_t tick; /**< Interrupt cycle the status was taken in, see @ref pwm_ticks */
+    int8_t active_slot; /**< Slot on the outputs (LIST MENU ORDER), -1 if none */
+    int8_t playlist; /**< Playlist running, -1 if none */
+    uint8_t playlist_step; /**< Step of the running playlist */
+    int8_t slow; /**< Slow signal sequence running, -1 if none */
+    uint16_t slow_time; /**< Half seconds since the slow sequence started */
+    uint8_t flags; /**< Bit 0: a morph is running */
+    uint8_t pin_states; /**< Level of every output, bit i for pin i */
+    uint16_t modes; /**< Mode of every output, bits 2i and 2i + 1 for pin i */
+    status_pin_t pins[NUM_PINS]; /**< Parameters of every output */
+    uint8_t isr_load; /**< Time spent in the PWM interrupt since the last periodic status (%) */
+    uint8_t queue_depth; /**< Events waiting to be handled */
+    uint16_t dropped; /**< Events dropped since boot, every source added up */
+    uint16_t skipped; /**< Status frames skipped because the TX buffer was full */
+} status_t;
+
+/**
+ * @brief Starts sending status frames
+ * 
+ * @param[in] seq Sequence number the frames will carry
+ * @param[in] period Time between frames, in ms. Raised to
+ * TELEMETRY_MIN_PERIOD if lower
+ */
+void telemetry_start(uint8_t seq, uint16_t period);
+
+/**
+ * @brief Stops sending status frames
+ */
+void telemetry_stop();
+
+/**
+ * @brief Takes the device's live state, as sent in status frames
+ * @details The interrupt load covers the time since the last
+ * periodic status frame, or since telemetry was started. Taking the
+ * state doesn't restart that window
+ * 
+ * @param[out] status Where the state will be stored
+ */
+void telemetry_get_status(status_t *status);
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* TELEMETRY_CONTROL_H */
@@ -45,11 +45,36 @@ void list_button_press();
  */
 void list_update_names();
 
+/**
+ * @brief Gets the slot on the outputs
+ * 
+ * @return int8_t Index of the slot (LIST MENU ORDER), -1 if none
+ */
+int8_t get_active_slot();
+
 /**
  * @brief Restores initial state
  */
 void unload_active_slot();
 
+/**
+ * @brief Loads a stored slot onto the outputs
+ * @details Every pin changes on the same interrupt cycle, see
+ * @ref commit_pins. Cancels any running morph
+ * 
+ * @param[in] ui_idx Index of the slot (LIST MENU ORDER)
+ */
+void load_slot(uint8_t ui_idx);
+
+/**
+ * @brief Puts a stored slot on the outputs, as the LOAD option
+ * does. Stops any running playlist or slow sequence first
+ * 
+ * @param[in] ui_idx Index of the slot (LIST MENU ORDER), -1 to
+ * unload the active one
+ */
+void activate_slot(int8_t ui_idx);
+
 
 #ifdef __cplusplus
     }
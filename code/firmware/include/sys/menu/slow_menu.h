@@ -18,7 +18,7 @@
     extern "C" {
 #endif
 
-int8_t slow_running;
+volatile int8_t slow_running;
 
 /**
  * @brief Initializes variables that need to be set on runtime,
@@ -26,6 +26,13 @@ int8_t slow_running;
  */
 void slow_menu_setup();
 
+/**
+ * @brief Gets the position of the running sequence
+ * 
+ * @return uint16_t Half seconds since it started
+ */
+uint16_t get_slow_time();
+
 /**
  * @brief Reloads the slow signals menu
  */
@@ -43,12 +50,28 @@ void slow_scroll(int8_t dir);
  */
 void slow_button_press();
 
+/**
+ * @brief Starts a sequence from outside the menu, as if it had
+ * been picked in it. The slow signals menu is shown and every
+ * output is turned off first
+ * 
+ * @param[in] idx Index of the sequence, -1 to stop the running
+ * one and turn every output off, as the button does
+ */
+void slow_start(int8_t idx);
+
+/**
+ * @brief Stops the running sequence, if any, leaving the outputs
+ * as they are
+ */
+void slow_stop();
+
 /**
  * @brief Manages the running sequence
  * 
- * @param[in] half_seconds Time counter
+ * @param[in] half_seconds Time since the sequence started
  */
-void slow_signal(uint64_t half_seconds);
+void slow_signal(uint16_t half_seconds);
 
 #ifdef __cplusplus
     }
@@ -78,6 +78,10 @@ Menu get_current_menu();
 
 /**
  * @brief Handles reloading the screen
+ * @details The screen is redrawn right away, unless it was
+ * already redrawn less than LCD_FRAME_TIME ago. In that case the
+ * redraw is put off until then, and every reload requested in the
+ * meantime is merged into it
  */
 void reload_screen();
 
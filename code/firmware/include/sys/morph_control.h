@@ -0,0 +1,53 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <morph_control.h> @endcode
+ * 
+ * @brief Timed transitions between the active configuration and
+ * a stored slot
+ */
+
+#ifndef MORPH_CONTROL_H
+#define MORPH_CONTROL_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/**
+ * @brief Starts interpolating every channel's frequency, duty
+ * cycle and phase from their current values to a stored slot's
+ * @details OFF and ON channels are treated as 0% and 100% duty
+ * cycles. Once the time is over, the slot is loaded as is
+ * 
+ * @param[in] ui_idx Index of the target slot (LIST MENU ORDER)
+ * @param[in] duration Transition time, in tenths of a second
+ * @return true If the morph has been started
+ * @return false If the slot doesn't exist
+ */
+bool morph_start(uint8_t ui_idx, uint16_t duration);
+
+/**
+ * @brief Stops the running morph, if any. Outputs keep their
+ * current intermediate values
+ */
+void morph_stop();
+
+/**
+ * @brief Checks whether a morph is running
+ * 
+ * @return true If a morph is running
+ * @return false If no morph is running
+ */
+bool morph_running();
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* MORPH_CONTROL_H */
@@ -0,0 +1,54 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <playlist_control.h> @endcode
+ * 
+ * @brief Steps through stored playlists of slots
+ */
+
+#ifndef PLAYLIST_CONTROL_H
+#define PLAYLIST_CONTROL_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/**
+ * @brief Starts running a playlist from its first step
+ * 
+ * @param[in] idx Index of the playlist
+ * @return true If the playlist has been started
+ * @return false If the playlist is unused
+ */
+bool playlist_start(uint8_t idx);
+
+/**
+ * @brief Stops the running playlist, if any. Outputs keep the
+ * last loaded slot
+ */
+void playlist_stop();
+
+/**
+ * @brief Gets the running playlist
+ * 
+ * @return int8_t Index of the running playlist, -1 if none
+ */
+int8_t playlist_running();
+
+/**
+ * @brief Gets the running playlist's current step
+ * 
+ * @return uint8_t Index of the current step
+ */
+uint8_t playlist_step();
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* PLAYLIST_CONTROL_H */
@@ -0,0 +1,105 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @file
+ * @code #include <scheduler.h> @endcode
+ * 
+ * @brief Cooperative timer wheel for housekeeping tasks
+ * @details Timers are hashed into SCHED_WHEEL_SIZE buckets by
+ * their deadline, so on every millisecond tick only one bucket
+ * is looked at, no matter how many timers there are. Deadlines
+ * are compared as signed differences, so time can wrap around
+ * 32 bits. Callbacks run from @ref sched_update, in the main
+ * loop, never from an interrupt
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#include "common/config.h"
+
+#if (SCHED_WHEEL_SIZE & (SCHED_WHEEL_SIZE - 1)) != 0
+    #error "SCHED_WHEEL_SIZE must be a power of two"
+#endif
+
+/**
+ * @brief Function run when a timer expires
+ */
+typedef void (*sched_callback_t)(void);
+
+/**
+ * @brief Definition of a timer
+ * @details Owned by the module registering it, usually as a
+ * static variable. Fields are only meant to be used by the
+ * scheduler
+ */
+typedef struct sched_timer_t {
+    sched_callback_t callback; /**< Function to run */
+    uint32_t deadline; /**< Tick in which the timer expires */
+    uint32_t period; /**< Period in ms, 0 for one-shot timers */
+    bool active; /**< Whether the timer is waiting to expire */
+    struct sched_timer_t *next; /**< Next timer in the same bucket */
+} sched_timer_t;
+
+/**
+ * @brief Initializes the scheduler's time base
+ */
+void sched_setup();
+
+/**
+ * @brief Arms a timer. If it was already armed, it's restarted
+ * 
+ * @param[in,out] timer Timer pointer
+ * @param[in] callback Function to run when it expires
+ * @param[in] delay Time until it first expires, in ms
+ * @param[in] period Time between further expirations, in ms.
+ * 0 for one-shot timers
+ */
+void sched_add(sched_timer_t *timer, sched_callback_t callback, uint32_t delay, uint32_t period);
+
+/**
+ * @brief Arms a timer again, counting from its last deadline
+ * instead of from now. Meant to be called from the timer's own
+ * callback, so chained one-shots with changing delays don't
+ * drift
+ * 
+ * @param[in,out] timer Timer pointer
+ * @param[in] delay Time after the last deadline, in ms
+ */
+void sched_restart(sched_timer_t *timer, uint32_t delay);
+
+/**
+ * @brief Disarms a timer. Nothing happens if it wasn't armed
+ * 
+ * @param[in,out] timer Timer pointer
+ */
+void sched_cancel(sched_timer_t *timer);
+
+/**
+ * @brief Checks whether a timer is armed
+ * 
+ * @param[in] timer Timer pointer
+ * @return true If it's waiting to expire
+ * @return false Otherwise
+ */
+bool sched_active(sched_timer_t *timer);
+
+/**
+ * @brief Runs every timer expired since the last call, in order.
+ * Meant to be called on every loop pass
+ */
+void sched_update();
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif /* SCHEDULER_H */
@@ -8,15 +8,16 @@
  */
 
 #include <Arduino.h>
+#include <avr/sleep.h>
 
 #include "common/config.h"
 #include "common/util.h"
-#include "common/queue.h"
 
 #include "sys/event_control.h"
 #include "sys/menu_control.h"
 #include "sys/eeprom_control.h"
 #include "sys/lcd_screen.h"
+#include "sys/scheduler.h"
 
 #include "sys/io/rotary_control.h"
 #include "sys/io/serial_control.h"
@@ -30,17 +31,34 @@
 
 pwm_pin_t pwms[NUM_PINS];
 
-queue_t events;
-int current_event; // C++ doesn't allow casting enum to int, so we cast to enum
+event_t current_event;
 
 bool push_during_startup = false;
-uint64_t time_ms = millis();
-uint64_t time_ms2 = millis();
-uint64_t idle_time = 0;
-uint64_t warn_time = 0;
+bool booted = false;
 
-uint64_t slow_time = 0;
-uint64_t prev_slow_time = 0;
+// Set by the rotary interrupts, so it can't be cached in a register
+volatile bool user_active = false;
+
+sched_timer_t boot_timer;
+sched_timer_t idle_timer;
+
+
+/*******************************************************************************
+ * Timed tasks
+ ******************************************************************************/
+
+// UI timeout has gone by with no user interaction
+void idle_timeout() {
+    if (get_current_menu() != INFO_MENU && slow_running == -1) change_menu(INFO_MENU);
+}
+
+void boot_timeout() {
+    if (push_during_startup) change_menu(SLOW_MENU);
+    else change_menu(LIST_MENU);
+
+    booted = true;
+    sched_add(&idle_timer, idle_timeout, UI_TIMEOUT * 1000UL, 0);
+}
 
 
 /*******************************************************************************
@@ -48,62 +66,60 @@ uint64_t prev_slow_time = 0;
  ******************************************************************************/
 
 void setup() {
+    sched_setup();
     serial_setup();
     rotary_setup();
     
     pins_init(pwms);
     eeprom_setup(pwms);
     menu_setup(pwms);
+    event_setup();
+
+    sched_add(&boot_timer, boot_timeout, UI_BOOT_DELAY * 1000UL, 0);
 
+    set_sleep_mode(SLEEP_MODE_IDLE);
     setup_pwm_interrupt();
 }
 
 void loop() {
-    delay(1); // Dont know why, it just doesn't work without this
-    Menu menu = get_current_menu();
+    event_pass_start();
 
-    // Handle timed stuff
-    if (millis() - time_ms > 1000) {  // Runs once per second
-        time_ms = millis();
+    // Any interaction restarts the UI timeout, and brings the
+    // screensaver back to the previous menu
+    if (user_active) {
+        user_active = false;
 
-        idle_time++;
-        if (menu == INFO_MENU || menu == WARN_MENU) warn_time++;
-    }
-
-    if (millis() - time_ms2 > 500) {  // Runs once every tenth of a second
-        time_ms2 = millis();
-
-        if (slow_running != -1) { slow_time++; }
-        else if (slow_time != 0) slow_time = 0;
+        if (booted) {
+            sched_add(&idle_timer, idle_timeout, UI_TIMEOUT * 1000UL, 0);
+            if (get_current_menu() == INFO_MENU) revert_menu();
+        }
     }
 
-    // Info menu is active
-    if (menu == INFO_MENU) {
-        // After boot delay
-        if ((time_ms / 1000) == UI_BOOT_DELAY) {
-            if (push_during_startup) change_menu(SLOW_MENU);
-            else change_menu(LIST_MENU);
+    sched_update();
 
-            idle_time = 0;
-        }
-        // After user interaction
-        else if ((time_ms / 1000) > UI_BOOT_DELAY && idle_time == 0) {
-            revert_menu();
-        }
-    }
-    // Warn menu is active, and the set delay has gone by
-    else if (menu == WARN_MENU && (warn_time == UI_BOOT_DELAY)) {
-        revert_menu();
-        warn_time = 0;
-    }
-    // UI timeout has gone by with no user interaction, and we are not in the boot sequence or running a slow signal
-    else if (idle_time == UI_TIMEOUT && (time_ms / 1000) > UI_BOOT_DELAY && slow_running == -1) {
-        change_menu(INFO_MENU);
+    // Handle every pending event, not just one per pass
+    while (event_pop(&current_event)) {
+        event_handler(current_event);
     }
 
-    if (queue_pop(&events, &current_event)) {
-        event_handler((event_t)current_event);
+    serial_update();
+    eeprom_update();
+
+    event_pass_end();
+
+    // Sleep until an interrupt posts work. Interrupts are disabled while
+    // checking the queue, and sei() only takes effect after the following
+    // instruction, so an event queued right before sleeping still wakes us.
+    // The PWM timer and millis() keep waking the loop up, so timed tasks
+    // still run on time
+    cli();
+    if (event_get_depth() == 0) {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
     }
+    sei();
 }
 
 
@@ -115,47 +131,42 @@ void loop() {
 
 ISR(TIMER2_COMPA_vect) {
     pwm_cycle(pwms);
-
-    if (slow_running != -1 && slow_time != prev_slow_time) {
-        prev_slow_time = slow_time;
-        slow_signal(slow_time);
-    }
 }
 
 
 /* Rotary *********************************************************************/
 
 ISR(INT1_vect) {
-    idle_time = 0;
+    user_active = true;
     rotary_result_t rot = rotation_handler();
 
-    if (rot == R_DIR_CW) queue_push(&events, EV_ROT_R);
-    else if (rot == R_DIR_CCW) queue_push(&events, EV_ROT_L);
+    if (rot == R_DIR_CW) event_push(EV_ROT_R);
+    else if (rot == R_DIR_CCW) event_push(EV_ROT_L);
 }
 
 ISR(INT2_vect){
-    idle_time = 0;
+    user_active = true;
     button_result_t push = push_handler_int();
     
-    if (push == B_PUSH) queue_push(&events, EV_ROT_P);
-    else if (push == B_HOLD) queue_push(&events, EV_ROT_H);
+    if (push == B_PUSH) event_push(EV_ROT_P);
+    else if (push == B_HOLD) event_push(EV_ROT_H);
 }
 
 ISR(INT3_vect) {
-    idle_time = 0;
+    user_active = true;
     rotary_result_t rot = rotation_handler();
 
-    if (rot == R_DIR_CW) queue_push(&events, EV_ROT_R);
-    else if (rot == R_DIR_CCW) queue_push(&events, EV_ROT_L);
+    if (rot == R_DIR_CW) event_push(EV_ROT_R);
+    else if (rot == R_DIR_CCW) event_push(EV_ROT_L);
 }
 
 
 /* UART ***********************************************************************/
 
 ISR (USART0_RX_vect) {
-    if (process_serial()) queue_push(&events, EV_SERIAL);
+    if (process_serial() && !event_push(EV_SERIAL)) serial_reject();
 }
 
-// Unhandled interrupts cause a reset, and we need RXCIE0 enabled for RX
-// interrupts to work
-ISR (USART0_UDRE_vect) { return; }
\ No newline at end of file
+ISR (USART0_UDRE_vect) {
+    serial_tx_next();
+}
\ No newline at end of file
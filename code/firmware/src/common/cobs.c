@@ -0,0 +1,75 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Consistent Overhead Byte Stuffing
+ */
+
+#include "common/cobs.h"
+
+uint8_t cobs_encode(const uint8_t *src, uint8_t len, uint8_t *dest) {
+    uint8_t code_pos = 0;  // Where the distance to the next zero goes
+    uint8_t out = 1;
+    uint8_t code = 1;
+
+    for (uint8_t i = 0; i < len; i++) {
+        if (src[i] == 0) {
+            dest[code_pos] = code;
+            code_pos = out++;
+            code = 1;
+        }
+        else {
+            dest[out++] = src[i];
+            code++;
+        }
+    }
+
+    dest[code_pos] = code;
+
+    return out;
+}
+
+int16_t cobs_decode(const uint8_t *src, uint8_t len, uint8_t *dest) {
+    uint8_t in = 0;
+    uint8_t out = 0;
+
+    while (in < len) {
+        uint8_t code = src[in++];
+
+        if (code == 0 || in + code - 1 > len) return -1;
+
+        // Output never gets ahead of input, so it can be done in place
+        for (uint8_t i = 1; i < code; i++) {
+            dest[out++] = src[in++];
+        }
+
+        // Every group but the last one stands for a zero
+        if (in < len) dest[out++] = 0;
+    }
+
+    return out;
+}
+
+uint8_t cobs_byte(const uint8_t *src, uint8_t len, uint8_t idx) {
+    uint8_t in = 0;
+    uint16_t out = 0;
+
+    while (in < len) {
+        uint8_t code = src[in++];
+
+        if (code == 0) return 0;
+
+        // It's one of the bytes of this group, or the zero after it
+        if (idx < out + code - 1) {
+            in += idx - out;
+            return in < len ? src[in] : 0;
+        }
+
+        if (idx == out + code - 1) return 0;
+
+        in += code - 1;
+        out += code;  // Including the zero the group stands for
+    }
+
+    return 0;
+}
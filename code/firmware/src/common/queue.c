@@ -6,35 +6,64 @@
  */
 
 #include "common/queue.h"
-#include "sys/io/serial_control.h"
 #include "common/config.h"
 
+#define QUEUE_MASK (EV_QUEUE_SIZE - 1)
+
 bool queue_empty(queue_t *q) {
     return q->r_ptr == q->w_ptr;
 }
 
 bool queue_full(queue_t *q) {
-    return q->r_ptr == ((q->w_ptr + 1) % EV_QUEUE_SIZE);
+    return (uint8_t)(q->w_ptr - q->r_ptr) == EV_QUEUE_SIZE;
+}
+
+uint8_t queue_depth(queue_t *q) {
+    return q->w_ptr - q->r_ptr;
+}
+
+uint8_t queue_max_depth(queue_t *q) {
+    return q->max_depth;
 }
 
-bool queue_pop(queue_t *q, int *data) {
-    if (queue_empty(q)) {
+bool queue_peek(queue_t *q, uint8_t *data) {
+    uint8_t r = q->r_ptr;
+
+    if (q->w_ptr == r) return false;
+
+    *data = q->buf[r & QUEUE_MASK];
+    return true;
+}
+
+bool queue_pop(queue_t *q, uint8_t *data, uint16_t *time) {
+    uint8_t r = q->r_ptr;
+
+    if (r == q->w_ptr) {
         return false;
     }
-    
-    *data = q->buf[q->r_ptr];
-    q->r_ptr = (q->r_ptr + 1) % EV_QUEUE_SIZE;
-    
+
+    *data = q->buf[r & QUEUE_MASK];
+    if (time != NULL) *time = q->time[r & QUEUE_MASK];
+    q->r_ptr = r + 1;  // Slot is only released after it's been read
+
     return true;
 }
 
-bool queue_push(queue_t *q, int data) {
-    if (queue_full(q)) {
+bool queue_push(queue_t *q, uint8_t data, uint16_t time) {
+    uint8_t w = q->w_ptr;
+
+    if ((uint8_t)(w - q->r_ptr) == EV_QUEUE_SIZE) {
         return false;
     }
 
-    q->buf[q->w_ptr] = data;
-    q->w_ptr = (q->w_ptr + 1) % EV_QUEUE_SIZE;
-    
+    q->buf[w & QUEUE_MASK] = data;
+    q->time[w & QUEUE_MASK] = time;
+    q->w_ptr = w + 1;  // Element is only published after it's been written
+
+    // Only the producer writes it, so it can be updated here
+    if ((uint8_t)(w + 1 - q->r_ptr) > q->max_depth) {
+        q->max_depth = w + 1 - q->r_ptr;
+    }
+
     return true;
 }
\ No newline at end of file
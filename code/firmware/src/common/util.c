@@ -34,6 +34,15 @@ int wrap(int num, int min, int max) {
     return num;
 }
 
+int wrap_around(int num, int min, int max) {
+    int range = max - min + 1;
+
+    num = (num - min) % range;
+    if (num < 0) num += range;
+
+    return num + min;
+}
+
 int wrap_hit(int num, int min, int max, bool *min_hit, bool *max_hit) {
     if (num < min) *min_hit = true;
     else if (num > max) *max_hit = true;
@@ -56,9 +65,47 @@ int limit_hit(int num, int min, int max, bool *min_hit, bool *max_hit) {
     return limit(num, min, max);
 }
 
+void scroll_window(uint8_t *first, uint8_t *line, int dir, int num_entries, int num_lines) {
+    int selected = wrap_around(*first + *line + dir, 0, num_entries - 1);
+
+    if (selected < *first) {  // Above the screen
+        *first = selected;
+        *line = 0;
+    }
+    else if (selected >= *first + num_lines) {  // Below the screen
+        *first = selected - num_lines + 1;
+        *line = num_lines - 1;
+    }
+    else {
+        *line = selected - *first;
+    }
+}
+
 int get_num_length(int num) {
     if (num < 10) return 1;
     else if (10 <= num && num < 100) return 2;
     else if (100 <= num && num < 1000)return 3;
     else return 4;
-}
\ No newline at end of file
+}
+
+uint8_t utos(uint16_t num, char *buf) {
+    static const uint16_t powers[] = { 10000, 1000, 100, 10 };
+    uint8_t len = 0;
+
+    for (uint8_t i = 0; i < 4; i++) {
+        char digit = '0';
+
+        // At most 9 subtractions, division is done in software
+        while (num >= powers[i]) {
+            num -= powers[i];
+            digit++;
+        }
+
+        if (digit != '0' || len != 0) buf[len++] = digit;
+    }
+
+    buf[len++] = num + '0';
+    buf[len] = '\0';
+
+    return len;
+}
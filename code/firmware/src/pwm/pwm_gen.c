@@ -9,6 +9,15 @@
 
 #include "pwm/pwm_gen.h"
 
+#include <util/atomic.h>
+
+static pwm_pin_t *volatile staged_pins = NULL;
+static volatile uint16_t apply_time = 0;
+static volatile uint32_t ticks = 0;
+static volatile uint32_t busy = 0;  // Timer2 counts spent in pwm_cycle
+static uint32_t load_ticks = 0;
+static uint32_t load_busy = 0;
+
 void setup_pwm_interrupt() {
     TCCR2A = 0;
     TCCR2B = 0;
@@ -35,6 +44,82 @@ void stop_clock() {
     TIMSK2 &= ~(1 << OCIE2A);
 }
 
+bool clock_running() {
+    return TIMSK2 & (1 << OCIE2A);
+}
+
+void stage_pins(pwm_pin_t *staged) {
+    staged_pins = staged;
+}
+
+bool pins_staged() {
+    return staged_pins != NULL;
+}
+
+uint16_t pins_apply_time() {
+    uint16_t time;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        time = apply_time;
+    }
+
+    return time;
+}
+
+uint32_t pwm_ticks() {
+    uint32_t now;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        now = ticks;
+    }
+
+    return now;
+}
+
+uint32_t pin_apply_tick(pwm_pin_t *pins, uint8_t pin) {
+    uint32_t tick;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        tick = pins[pin].apply_tick;
+    }
+
+    return tick;
+}
+
+static uint8_t load_window(bool restart) {
+    uint32_t now, spent, elapsed;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        now = ticks;
+        spent = busy;
+    }
+
+    elapsed = now - load_ticks;
+    spent -= load_busy;
+
+    if (restart) {
+        load_ticks = now;
+        load_busy += spent;
+    }
+
+    // Past this the busy count may have wrapped as well, so there's no telling
+    if (elapsed > UINT32_MAX / (OCR2A + 1)) return 0;
+
+    elapsed = elapsed * (OCR2A + 1) / 100;
+    if (elapsed == 0) return 0;
+
+    spent /= elapsed;
+    return spent > 100 ? 100 : spent;
+}
+
+uint8_t pwm_load() {
+    return load_window(true);
+}
+
+uint8_t pwm_load_peek() {
+    return load_window(false);
+}
+
 void turn_on(uint8_t *port, uint8_t pin) {
     *port |= _BV(pin);
 }
@@ -44,6 +129,22 @@ void turn_off(uint8_t *port, uint8_t pin) {
 }
 
 void pwm_cycle(pwm_pin_t * pwm_pins) {
+    ticks++;
+
+    // Swap in a whole new configuration at once
+    if (staged_pins != NULL) {
+        for (int i = 0; i < NUM_PINS; i++) {
+            pwm_pins[i].mode = staged_pins[i].mode;
+            pwm_pins[i].cycles_on = staged_pins[i].cycles_on;
+            pwm_pins[i].cycles_total = staged_pins[i].cycles_total;
+            pwm_pins[i].cnt = staged_pins[i].cnt;
+            pwm_pins[i].pending = false;
+        }
+
+        staged_pins = NULL;
+        apply_time = TCNT1;
+    }
+
     for (int i = 0; i < NUM_PINS; i++) {
         switch (pwm_pins[i].mode) {
             case OFF_MODE:
@@ -51,11 +152,24 @@ void pwm_cycle(pwm_pin_t * pwm_pins) {
                 break;
             case PWM_MODE:
                 if (pwm_pins[i].cnt >= pwm_pins[i].cycles_total) {
-                    if(pwm_pins[i].cycles_on != 0){
-                        turn_on(pwm_pins[i].port, pwm_pins[i].pin);
+                    pwm_pins[i].cnt = 0; // Reset counter
+
+                    // Period boundary, apply pending changes
+                    if (pwm_pins[i].pending) {
+                        pwm_pins[i].cycles_on = pwm_pins[i].next_on;
+                        pwm_pins[i].cycles_total = pwm_pins[i].next_total;
+                        pwm_pins[i].cnt = pwm_pins[i].next_cnt;
+                        pwm_pins[i].pending = false;
+                        pwm_pins[i].apply_tick = ticks;
+                        apply_time = TCNT1;
                     }
 
-                    pwm_pins[i].cnt = 0; // Reset counter
+                    if (pwm_pins[i].cnt < pwm_pins[i].cycles_on) {
+                        turn_on(pwm_pins[i].port, pwm_pins[i].pin);
+                    }
+                    else {
+                        turn_off(pwm_pins[i].port, pwm_pins[i].pin);
+                    }
                 }
                 else {
                     if (pwm_pins[i].cnt == pwm_pins[i].cycles_on) {
@@ -72,4 +186,6 @@ void pwm_cycle(pwm_pin_t * pwm_pins) {
                 break;
         }
     }
+
+    busy += TCNT2;
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 
 #include "pwm/virtual_PWM.h"
 
+#include <string.h>
+
 void set_pin_mode(pwm_pin_t *pins, uint8_t pin, pin_mode mode){
     pins[pin].mode = mode;
 }
@@ -19,12 +21,14 @@ void set_pin_phase(pwm_pin_t *pins, uint8_t pin, int16_t phs) {
 }
 
 void set_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty) {
-    if (frq > 4000) frq = 4000;
+    if (frq > PWM_MAX_FRQ) frq = PWM_MAX_FRQ;
+    if (frq == 0) frq = 1;  // OFF and ON slots may hold 0
     if (dty > 100) dty = 100;
 
-    uint32_t per = 200000U / frq;
+    uint32_t per = PWM_TICKS_X10 / frq;
     uint32_t ton = per * dty / 100U;
 
+    pins[pin].pending = false;  // Overrides any queued change
     pins[pin].cycles_total = per;
     pins[pin].cycles_on = ton;
     pins[pin].frq = (uint16_t)frq;
@@ -33,6 +37,41 @@ void set_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty) {
     pin_config(pins, pin, 1);
 }
 
+bool queue_pin_config(pwm_pin_t *pins, uint8_t pin, uint32_t frq, uint32_t dty, int16_t phs) {
+    if (pins[pin].pending) return false;
+
+    if (frq > PWM_MAX_FRQ) frq = PWM_MAX_FRQ;
+    if (frq == 0) frq = 1;
+    if (dty > 100) dty = 100;
+
+    uint32_t per = PWM_TICKS_X10 / frq;
+
+    // Whole periods of phase change nothing, so the shift always ends
+    // up within the new period
+    int32_t delta = ((int32_t)phs - pins[pin].phs) % 100;
+    int32_t shift = (int32_t)per * delta / 100;
+
+    if (shift < 0) shift += per;
+
+    pins[pin].next_total = per;
+    pins[pin].next_on = per * dty / 100U;
+    pins[pin].next_cnt = shift;
+    pins[pin].pending = true;
+
+    pins[pin].frq = (uint16_t)frq;
+    pins[pin].dty = (uint16_t)dty;
+    pins[pin].phs = phs;
+
+    return true;
+}
+
+bool pin_values_valid(uint8_t mode, uint16_t frq, uint16_t dty, int16_t phs) {
+    if (mode > ON_MODE || frq > PWM_MAX_FRQ || dty > 100) return false;
+    if (phs < -99 || phs > 99) return false;
+
+    return mode != PWM_MODE || frq != 0;
+}
+
 void pins_init(pwm_pin_t *pins){
     pins[0].port = &(PWM_PORT_0);
     pins[0].port_config = &(PWM_PORT_CONF_0);
@@ -78,6 +117,41 @@ void sync_pwms(pwm_pin_t *pins) {
     start_clock();
 }
 
+void copy_pins(pwm_pin_t *pins, pwm_pin_t *dest) {
+    memcpy(dest, pins, NUM_PINS * sizeof(pwm_pin_t));
+}
+
+void commit_pins(pwm_pin_t *pins, pwm_pin_t *staged) {
+    for (int i = 0; i < NUM_PINS; i++) {
+        // Reduced to a single period, like in queue_pin_config
+        int32_t offset = (int32_t)staged[i].cycles_total * (staged[i].phs % 100) / 100;
+
+        // Negative phases start that far before the end of the period
+        if (offset < 0) offset += staged[i].cycles_total;
+        staged[i].cnt = offset;
+    }
+
+    if (clock_running()) {
+        stage_pins(staged);
+        while (pins_staged());  // Takes one interrupt cycle at most
+    }
+    else {
+        for (int i = 0; i < NUM_PINS; i++) {
+            pins[i].mode = staged[i].mode;
+            pins[i].cycles_on = staged[i].cycles_on;
+            pins[i].cycles_total = staged[i].cycles_total;
+            pins[i].cnt = staged[i].cnt;
+        }
+    }
+
+    // Not used by the interrupt, safe to copy afterwards
+    for (int i = 0; i < NUM_PINS; i++) {
+        pins[i].frq = staged[i].frq;
+        pins[i].dty = staged[i].dty;
+        pins[i].phs = staged[i].phs;
+    }
+}
+
 void pin_config(pwm_pin_t *pins, uint8_t pin, uint8_t state){
     if (state){
         *(pins[pin].port_config) |= _BV(pins[pin].pin);
@@ -85,4 +159,14 @@ void pin_config(pwm_pin_t *pins, uint8_t pin, uint8_t state){
     else {
         *(pins[pin].port_config) &= (0xFF & (~(_BV(pins[pin].pin))));
     }
-}
\ No newline at end of file
+}
+
+bool pins_pending(pwm_pin_t *pins) {
+    if (pins_staged()) return true;
+
+    for (int i = 0; i < NUM_PINS; i++) {
+        if (pins[i].pending) return true;
+    }
+
+    return false;
+}
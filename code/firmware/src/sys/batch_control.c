@@ -0,0 +1,123 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ * 
+ * @brief Configuration changes applied together
+ */
+
+#include "sys/batch_control.h"
+
+#include "common/config.h"
+#include "pwm/virtual_PWM.h"
+#include "sys/eeprom_control.h"
+#include "sys/menu/slow_menu.h"
+#include "sys/menu_control.h"
+#include "sys/morph_control.h"
+#include "sys/playlist_control.h"
+#include "sys/scheduler.h"
+
+/**
+ * @brief Recorded channel change
+ */
+typedef struct batch_pin_t {
+    uint8_t mode; /**< Channel mode */
+    uint16_t frq; /**< Frequency */
+    uint16_t dty; /**< Duty cycle */
+    int16_t phs; /**< Phase */
+} batch_pin_t;
+
+static bool open = false;
+static sched_timer_t batch_timer;
+static batch_pin_t pins[NUM_PINS];
+static uint8_t pins_set = 0;  // Bit i is set if channel i changes
+static bool default_set = false;
+static int8_t default_slot;
+static bool brightness_set = false;
+static uint8_t brightness;
+
+
+/* Definitions */
+
+void batch_begin() {
+    open = true;
+    pins_set = 0;
+    default_set = false;
+    brightness_set = false;
+
+    sched_add(&batch_timer, batch_abort, BATCH_TIMEOUT, 0);
+}
+
+uint8_t batch_commit() {
+    uint8_t changes = 0;
+
+    if (!open) return 0;
+
+    batch_abort();
+
+    if (pins_set != 0) {
+        pwm_pin_t staged[NUM_PINS];
+
+        // They would overwrite the new values on their next step
+        morph_stop();
+        playlist_stop();
+        if (slow_running != -1) slow_stop();
+
+        copy_pins(active_pins, staged);
+
+        for (uint8_t i = 0; i < NUM_PINS; i++) {
+            if (!(pins_set & _BV(i))) continue;
+
+            set_pin_mode(staged, i, pins[i].mode);
+            set_pin_config(staged, i, pins[i].frq == 0 ? 1 : pins[i].frq, pins[i].dty);
+            staged[i].phs = pins[i].phs;
+            changes++;
+        }
+
+        commit_pins(active_pins, staged);
+    }
+
+    // Both are marked before the EEPROM writer gets to run, so
+    // they're written in a single pass
+    if (default_set) {
+        eeprom_set_default_slot(default_slot);
+        changes++;
+    }
+
+    if (brightness_set) {
+        set_brightness(brightness);
+        eeprom_set_brightness(brightness);
+        changes++;
+    }
+
+    reload_screen();
+
+    return changes;
+}
+
+void batch_abort() {
+    open = false;
+    sched_cancel(&batch_timer);
+}
+
+bool batch_active() {
+    return open;
+}
+
+void batch_set_pin(uint8_t pin, uint8_t mode, uint16_t frq, uint16_t dty, int16_t phs) {
+    pins[pin].mode = mode;
+    pins[pin].frq = frq;
+    pins[pin].dty = dty;
+    pins[pin].phs = phs;
+
+    pins_set |= _BV(pin);
+}
+
+void batch_set_default_slot(int8_t slot) {
+    default_slot = slot;
+    default_set = true;
+}
+
+void batch_set_brightness(uint8_t value) {
+    brightness = value;
+    brightness_set = true;
+}
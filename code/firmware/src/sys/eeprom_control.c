@@ -15,17 +15,219 @@
 #include "sys/lcd_screen.h"
 
 #include <string.h>
+#include <util/crc16.h>
 
 eeprom_t eeprom_vars EEMEM = { 0x0 };
 eeprom_t ram_vars = { 0x0 };
 
+// Range of ram_vars (as byte offsets) that may differ from the EEPROM
+static uint16_t dirty_start = 0;
+static uint16_t dirty_end = 0;
+
+// Content hash of every slot (EEPROM order), so the app can tell
+// which ones changed without reading them
+static uint16_t slot_crcs[NUM_SLOTS];
+
+// An image is being received into ram_vars, the EEPROM still holds
+// the previous contents
+static bool restoring = false;
+
+
+/* Local declarations */
+
+void mark_dirty(void *ram_ptr, uint16_t size);
+uint16_t slot_crc(slot_t *slot);
+uint16_t crc_string(uint16_t crc, const char *str, uint8_t size);
+uint16_t crc_word(uint16_t crc, uint16_t value);
+bool image_valid();
+
+
+/* Definitions */
+
 void slot_to_eeprom(slot_t *slot, uint8_t eeprom_idx) {
     memcpy(&ram_vars.slots[eeprom_idx], slot, sizeof(slot_t));
-    eeprom_write_block(&ram_vars.slots[eeprom_idx], &eeprom_vars.slots[eeprom_idx], sizeof(slot_t));
+    mark_dirty(&ram_vars.slots[eeprom_idx], sizeof(slot_t));
+
+    slot_crcs[eeprom_idx] = slot_crc(slot);
 }
 
 void used_to_eeprom() {
-    eeprom_write_block(&ram_vars.used_slots, &eeprom_vars.used_slots, sizeof(array_t));
+    mark_dirty(&ram_vars.used_slots, sizeof(array_t));
+}
+
+void playlist_to_eeprom(uint8_t idx) {
+    mark_dirty(&ram_vars.playlists[idx], sizeof(playlist_t));
+}
+
+void mark_dirty(void *ram_ptr, uint16_t size) {
+    uint16_t start = (uint8_t *)ram_ptr - (uint8_t *)&ram_vars;
+    uint16_t end = start + size;
+
+    if (dirty_start == dirty_end) {
+        dirty_start = start;
+        dirty_end = end;
+    }
+    else {
+        // A single range is enough, unchanged bytes in between are
+        // skipped anyway
+        if (start < dirty_start) dirty_start = start;
+        if (end > dirty_end) dirty_end = end;
+    }
+}
+
+void eeprom_update() {
+    if (restoring) return;
+
+    for (uint8_t i = 0; i < EE_MAX_COMPARES && dirty_start != dirty_end; i++) {
+        if (!eeprom_is_ready()) return;
+
+        uint8_t *address = (uint8_t *)&eeprom_vars + dirty_start;
+        uint8_t value = ((uint8_t *)&ram_vars)[dirty_start];
+
+        dirty_start++;
+
+        // The write goes on in the background for a few ms
+        if (eeprom_read_byte(address) != value) {
+            eeprom_write_byte(address, value);
+            return;
+        }
+    }
+}
+
+uint16_t slot_crc(slot_t *slot) {
+    // Only what the app sees: names up to their terminator, whatever
+    // follows them in the buffer is ignored
+    uint16_t crc = crc_string(0xFFFF, slot->name, EE_SLOT_NAME_SIZE);
+
+    for (uint8_t i = 0; i < NUM_PINS; i++) {
+        crc = crc_string(crc, slot->pwms[i].name, EE_PWM_NAME_SIZE);
+        crc = _crc_xmodem_update(crc, slot->pwms[i].mode);
+        crc = crc_word(crc, slot->pwms[i].frq);
+        crc = crc_word(crc, slot->pwms[i].dty);
+        crc = crc_word(crc, slot->pwms[i].phs);
+    }
+
+    return crc;
+}
+
+uint16_t crc_string(uint16_t crc, const char *str, uint8_t size) {
+    uint8_t i = 0;
+
+    do {
+        crc = _crc_xmodem_update(crc, i < size - 1 ? str[i] : '\0');
+    } while (i < size - 1 && str[i++] != '\0');
+
+    return crc;
+}
+
+uint16_t crc_word(uint16_t crc, uint16_t value) {
+    crc = _crc_xmodem_update(crc, value & 0xFF);
+    return _crc_xmodem_update(crc, value >> 8);
+}
+
+bool eeprom_pending() {
+    return dirty_start != dirty_end;
+}
+
+void eeprom_read_image(uint16_t offset, void *dest, uint8_t len) {
+    memcpy(dest, (uint8_t *)&ram_vars + offset, len);
+}
+
+uint16_t eeprom_image_crc() {
+    uint16_t crc = 0xFFFF;
+
+    for (uint16_t i = 0; i < sizeof(eeprom_t); i++) {
+        crc = _crc_xmodem_update(crc, ((uint8_t *)&ram_vars)[i]);
+    }
+
+    return crc;
+}
+
+bool eeprom_restore_begin() {
+    // The EEPROM must match ram_vars, it's the copy to go back to
+    if (!restoring && eeprom_pending()) return false;
+
+    restoring = true;
+    return true;
+}
+
+bool eeprom_restoring() {
+    return restoring;
+}
+
+void eeprom_restore_chunk(uint16_t offset, const void *data, uint8_t len) {
+    memcpy((uint8_t *)&ram_vars + offset, data, len);
+}
+
+bool eeprom_restore_end(uint16_t crc) {
+    if (!restoring) return false;
+
+    if (eeprom_image_crc() != crc || !image_valid()) {
+        eeprom_restore_abort();
+        return false;
+    }
+
+    restoring = false;
+
+    // Images are cloned from other devices
+    ram_vars.serial = eeprom_read_word(&eeprom_vars.serial);
+
+    // Unchanged bytes are skipped by eeprom_update
+    mark_dirty(&ram_vars, sizeof(eeprom_t));
+
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        slot_crcs[i] = slot_crc(&ram_vars.slots[i]);
+    }
+
+    return true;
+}
+
+void eeprom_restore_abort() {
+    if (!restoring) return;
+
+    restoring = false;
+    eeprom_read_block(&ram_vars, &eeprom_vars, sizeof(eeprom_t));
+}
+
+bool image_valid() {
+    uint8_t used = array_size(&ram_vars.used_slots);
+
+    if (ram_vars.init_val != 0x69 || used > NUM_SLOTS ||
+        ram_vars.used_slots.max_size != NUM_SLOTS) return false;
+
+    if (ram_vars.default_slot < -1 || ram_vars.default_slot >= used) return false;
+    if (ram_vars.brightness > LCD_MAX_BRIGHTNESS) return false;
+
+    bool listed[NUM_SLOTS];
+    memset(listed, 0, sizeof(listed));
+
+    // Each slot listed once, new and delete rely on it
+    for (uint8_t i = 0; i < used; i++) {
+        uint8_t idx = array_get(&ram_vars.used_slots, i);
+
+        if (idx >= NUM_SLOTS || listed[idx]) return false;
+        listed[idx] = true;
+    }
+
+    for (uint8_t i = 0; i < NUM_SLOTS; i++) {
+        slot_t *slot = &ram_vars.slots[i];
+
+        // Read as a byte, the image may hold anything there
+        if (*(uint8_t *)&slot->used != listed[i]) return false;
+        if (!listed[i]) continue;
+
+        // They're put on the outputs as they are
+        for (uint8_t j = 0; j < NUM_PINS; j++) {
+            if (!pin_values_valid(slot->pwms[j].mode, slot->pwms[j].frq,
+                                  slot->pwms[j].dty, slot->pwms[j].phs)) return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < NUM_PLAYLISTS; i++) {
+        if (ram_vars.playlists[i].num_steps > PL_MAX_STEPS) return false;
+    }
+
+    return true;
 }
 
 void eeprom_setup(pwm_pin_t *pins) {
@@ -44,6 +246,14 @@ void eeprom_setup(pwm_pin_t *pins) {
     else {
         eeprom_read_block(&ram_vars, &eeprom_vars, sizeof(eeprom_t));
 
+        // Memory initialized before playlists existed reads as 0xFF
+        for (int i = 0; i < NUM_PLAYLISTS; i++) {
+            if (ram_vars.playlists[i].num_steps > PL_MAX_STEPS) {
+                memset(&ram_vars.playlists[i], 0, sizeof(playlist_t));
+                playlist_to_eeprom(i);
+            }
+        }
+
         if (ram_vars.default_slot != -1) {
             // TODO: Handle in PWM control file ¿?
             slot_t to_load;
@@ -58,6 +268,10 @@ void eeprom_setup(pwm_pin_t *pins) {
             sync_pwms(pins);
         }
     }
+
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        slot_crcs[i] = slot_crc(&ram_vars.slots[i]);
+    }
 }
 
 uint8_t eeprom_get_init_val() {
@@ -65,46 +279,89 @@ uint8_t eeprom_get_init_val() {
 }
 
 uint16_t eeprom_get_serial() {
+    // The EEPROM still holds the previous contents while restoring
+    if (restoring) return eeprom_read_word(&eeprom_vars.serial);
+
     return ram_vars.serial;
 }
 
 int8_t *eeprom_get_password(int8_t *dest) {
+    if (restoring) {
+        eeprom_read_block(dest, eeprom_vars.password, sizeof(ram_vars.password));
+        return dest;
+    }
+
     memcpy(dest, ram_vars.password, sizeof(ram_vars.password));
     return dest;
 }
 
 int8_t eeprom_get_default_slot() {
+    if (restoring) return -1;
+
     return ram_vars.default_slot;
 }
 
 uint8_t eeprom_get_used_slots() {
+    // The library is empty until the image is whole
+    if (restoring) return 0;
+
     return array_size(&ram_vars.used_slots);
 }
 
 uint8_t eeprom_get_brightness() {
+    if (restoring) return eeprom_read_byte(&eeprom_vars.brightness);
+
     return ram_vars.brightness;
 }
 
 slot_t *eeprom_get_slot(uint8_t ui_idx, slot_t *dest) {
+    // Indexes in a partial image may be out of range
+    if (restoring) { memset(dest, 0, sizeof(slot_t)); return dest; }
+
     uint8_t eeprom_idx = array_get(&ram_vars.used_slots, ui_idx);
     memcpy(dest, &ram_vars.slots[eeprom_idx], sizeof(slot_t));
     return dest;
 }
 
+uint16_t eeprom_get_slot_crc(uint8_t ui_idx) {
+    if (restoring) return 0;
+
+    return slot_crcs[array_get(&ram_vars.used_slots, ui_idx)];
+}
+
 char *eeprom_get_slot_name(uint8_t ui_idx, char *dest) {
+    if (restoring) { dest[0] = '\0'; return dest; }
+
     uint8_t eeprom_idx = array_get(&ram_vars.used_slots, ui_idx);
     memcpy(dest, ram_vars.slots[eeprom_idx].name, EE_SLOT_NAME_SIZE * sizeof(char));
     return dest;
 }
 
+playlist_t *eeprom_get_playlist(uint8_t idx, playlist_t *dest) {
+    if (restoring) { memset(dest, 0, sizeof(playlist_t)); return dest; }
+
+    memcpy(dest, &ram_vars.playlists[idx], sizeof(playlist_t));
+    return dest;
+}
+
+uint8_t eeprom_get_playlist_steps(uint8_t idx) {
+    if (restoring) return 0;
+
+    return ram_vars.playlists[idx].num_steps;
+}
+
 void eeprom_set_serial(uint16_t value) {
+    if (restoring) return;
+
     if (value != ram_vars.serial) {
         ram_vars.serial = value;
-        eeprom_write_word(&eeprom_vars.serial, ram_vars.serial);
+        mark_dirty(&ram_vars.serial, sizeof(ram_vars.serial));
     }
 }
 
 void eeprom_set_password(int8_t *values) {
+    if (restoring) return;
+
     uint8_t different = 0;
 
     for (int i = 0; i < 3 && !different; i++) {
@@ -113,23 +370,29 @@ void eeprom_set_password(int8_t *values) {
 
     if (different) {
         memcpy(ram_vars.password, values, 3 * sizeof(int8_t));
-        eeprom_write_block(ram_vars.password, eeprom_vars.password, 3 * sizeof(int8_t));
+        mark_dirty(ram_vars.password, 3 * sizeof(int8_t));
     }
 }
 
 void eeprom_set_default_slot(int8_t value) {
+    if (restoring) return;
+
     ram_vars.default_slot = value;
-    eeprom_write_byte((uint8_t *)&eeprom_vars.default_slot, value);
+    mark_dirty(&ram_vars.default_slot, sizeof(int8_t));
 }
 
 void eeprom_set_brightness(uint8_t value) {
+    if (restoring) return;
+
     if (value != ram_vars.brightness) {
         ram_vars.brightness = value;
-        eeprom_write_byte(&eeprom_vars.brightness, ram_vars.brightness);
+        mark_dirty(&ram_vars.brightness, sizeof(uint8_t));
     }
 }
 
 bool eeprom_new_slot(slot_t *slot) {
+    if (restoring) return false;
+
     int8_t eeprom_idx = -1;
 
     for (int i = 0; i < NUM_SLOTS && eeprom_idx == -1; i++) {
@@ -160,11 +423,15 @@ bool eeprom_new_slot(slot_t *slot) {
 }
 
 void eeprom_overwrite_slot(uint8_t ui_idx, slot_t *slot) {
+    if (restoring) return;
+
     uint8_t eeprom_idx = array_get(&ram_vars.used_slots, ui_idx);
     slot_to_eeprom(slot, eeprom_idx);
 }
 
 void eeprom_delete_slot(uint8_t ui_idx) {
+    if (restoring) return;
+
     uint8_t eeprom_idx = array_get(&ram_vars.used_slots, ui_idx);
 
     slot_t to_delete;
@@ -182,13 +449,26 @@ void eeprom_delete_slot(uint8_t ui_idx) {
 }
 
 void eeprom_delete_all_slots() {
+    if (restoring) return;
+
     memset(&ram_vars.slots, 0, NUM_SLOTS*sizeof(slot_t));
     array_empty(&ram_vars.used_slots);
     used_to_eeprom();
 }
 
+void eeprom_truncate_slots(uint8_t num_slots) {
+    // eeprom_delete_slot would never shrink it
+    if (restoring) return;
+
+    while (array_size(&ram_vars.used_slots) > num_slots) {
+        eeprom_delete_slot(array_size(&ram_vars.used_slots) - 1);
+    }
+}
+
 void eeprom_set_pwm(uint8_t ui_idx, uint8_t pwm_idx, pwm_t *pwm)
 {
+    if (restoring) return;
+
     slot_t slot;
     eeprom_get_slot(ui_idx, &slot);
 
@@ -198,6 +478,13 @@ void eeprom_set_pwm(uint8_t ui_idx, uint8_t pwm_idx, pwm_t *pwm)
     slot_to_eeprom(&slot, eeprom_idx);
 }
 
+void eeprom_set_playlist(uint8_t idx, playlist_t *playlist) {
+    if (restoring) return;
+
+    memcpy(&ram_vars.playlists[idx], playlist, sizeof(playlist_t));
+    playlist_to_eeprom(idx);
+}
+
 void ram_set_slot(slot_t *slot, uint8_t idx) {
     memcpy(&slot, &ram_vars.slots[idx], sizeof(slot_t));
 }
@@ -13,13 +13,152 @@
 #include "common/queue.h"
 #include "common/config.h"
 
+#include <util/atomic.h>
+#include <string.h>
+
+static queue_t events;
+static volatile uint16_t dropped[EV_COUNT];
+
+static uint16_t current_time;  // Timestamp of the event being handled
+static uint16_t histograms[LAT_NUM_HISTS][LAT_HIST_BINS];
+static uint16_t max_latency = 0;
+
+static uint32_t pass_start;
+static uint16_t max_stall = 0;
+
+
+/* Local declarations */
+
+int8_t merge_rotations(int8_t steps);
+
+
+/* Definitions */
+
+void event_setup() {
+    // Normal mode, the Arduino core sets it up for PWM
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11) | _BV(CS10);
+
+    #ifdef DEBUG_LATENCY
+        DDRB |= _BV(6);
+        PORTB &= ~_BV(6);
+    #endif
+}
+
+uint16_t event_now() {
+    uint16_t now;
+
+    // 16-bit timer registers are read through a shared temporary one
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        now = TCNT1;
+    }
+
+    return now;
+}
+
+uint16_t event_get_time() {
+    return current_time;
+}
+
+bool event_push(event_t ev) {
+    // Only called from interrupts, so TCNT1 can be read directly
+    if (queue_push(&events, ev, TCNT1)) {
+        #ifdef DEBUG_LATENCY
+            PORTB |= _BV(6);
+        #endif
+
+        return true;
+    }
+
+    if (dropped[ev] != UINT16_MAX) dropped[ev]++;
+
+    return false;
+}
+
+bool event_pop(event_t *ev) {
+    uint8_t data;
+
+    if (!queue_pop(&events, &data, &current_time)) return false;
+
+    #ifdef DEBUG_LATENCY
+        if (queue_empty(&events)) PORTB &= ~_BV(6);
+    #endif
+
+    uint16_t latency = event_now() - current_time;
+    event_record_latency(data - 1, latency);
+
+    if (latency > UINT16_MAX / LAT_TICK_US) max_latency = UINT16_MAX;
+    else if (latency * LAT_TICK_US > max_latency) max_latency = latency * LAT_TICK_US;
+
+    *ev = (event_t)data;
+    return true;
+}
+
+void event_record_latency(uint8_t hist, uint16_t ticks) {
+    uint8_t bin = 0;
+
+    // Number of significant bits
+    while (ticks != 0) {
+        bin++;
+        ticks >>= 1;
+    }
+
+    if (histograms[hist][bin] != UINT16_MAX) histograms[hist][bin]++;
+}
+
+uint16_t event_get_histogram(uint8_t hist, uint8_t bin) {
+    return histograms[hist][bin];
+}
+
+void event_clear_histograms() {
+    memset(histograms, 0, sizeof(histograms));
+    max_latency = 0;
+}
+
+uint16_t event_get_dropped(event_t ev) {
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = dropped[ev];
+    }
+
+    return count;
+}
+
+uint16_t event_get_max_latency() {
+    return max_latency;
+}
+
+void event_pass_start() {
+    pass_start = micros();
+}
+
+void event_pass_end() {
+    uint32_t stall = micros() - pass_start;
+
+    if (stall > UINT16_MAX) stall = UINT16_MAX;
+    if (stall > max_stall) max_stall = stall;
+}
+
+uint16_t event_get_max_stall() {
+    return max_stall;
+}
+
+uint8_t event_get_depth() {
+    return queue_depth(&events);
+}
+
+uint8_t event_get_max_depth() {
+    return queue_max_depth(&events);
+}
+
 void event_handler(event_t ev) {
     switch (ev) {
         case EV_ROT_L:
-            scroll(EV_ROT_L);
+            scroll(merge_rotations(-1));
             break;
         case EV_ROT_R:
-            scroll(EV_ROT_R);
+            scroll(merge_rotations(1));
             break;
         case EV_ROT_P:
             button_press();
@@ -32,6 +171,26 @@ void event_handler(event_t ev) {
             process_data();
             break;
         case EV_NONE:
+        case EV_COUNT:
             break;
     }
-}
\ No newline at end of file
+}
+
+// Takes the rotations queued right after the current one out of the
+// queue, so a fast spin is handled as a single multi-step scroll. Only
+// consecutive rotations are merged, so the order with other events is
+// kept
+int8_t merge_rotations(int8_t steps) {
+    uint8_t next;
+    event_t merged;
+
+    while (steps > INT8_MIN + 1 && steps < INT8_MAX && queue_peek(&events, &next)) {
+        if (next == EV_ROT_L) steps--;
+        else if (next == EV_ROT_R) steps++;
+        else break;
+
+        event_pop(&merged);  // Its latency is recorded too
+    }
+
+    return steps;
+}
@@ -0,0 +1,626 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Framing and handling of the binary serial protocol
+ */
+
+#include "sys/io/frame_control.h"
+
+#include <util/crc16.h>
+
+#include "common/cobs.h"
+#include "common/task.h"
+#include "sys/io/serial_control.h"
+#include "sys/eeprom_control.h"
+#include "sys/scheduler.h"
+#include "sys/io/telemetry_control.h"
+#include "sys/menu_control.h"
+#include "sys/morph_control.h"
+#include "sys/playlist_control.h"
+#include "sys/menu/list_menu.h"
+#include "sys/menu/slow_menu.h"
+#include "pwm/virtual_PWM.h"
+
+// Payloads are copied straight from the firmware's structures
+#define PWM_DATA_SIZE (2 + sizeof(pwm_t))
+#define SLOT_DATA_SIZE (1 + EE_SLOT_NAME_SIZE)
+
+#if (2 + EE_PWM_NAME_SIZE + 7) > FRAME_MAX_DATA || SLOT_DATA_SIZE > FRAME_MAX_DATA
+    #error "Slots don't fit in a frame"
+#endif
+
+#define LIVE_DATA_SIZE 8
+
+// Offset (uint16_t) and image bytes
+#define IMAGE_CHUNK (FRAME_MAX_DATA - 2)
+
+#if (1 + 2 * NUM_SLOTS) > FRAME_MAX_DATA
+    #error "Slot hashes don't fit in a frame"
+#endif
+
+static uint8_t tx_frame[FRAME_MAX_DATA + 4];
+static uint8_t tx_encoded[FRAME_MAX_DATA + 5];
+static sched_timer_t link_timer;
+// Slots being replied to FR_GET_SLOTS or FR_GET_SLOT
+static uint8_t dump_seq;
+static uint8_t dump_first;
+static uint8_t dump_last;
+static bool dump_count;  // Whether FR_SLOT_COUNT goes first
+
+// Upload window, expected_seq is the next frame to apply
+static bool upload_active = false;
+static uint8_t expected_seq;
+static uint16_t image_next;  // Next byte of the image being restored
+
+// Live changes waiting to be confirmed, one bit per pin
+static uint8_t live_waiting = 0;
+static uint8_t live_seq[NUM_PINS];
+
+
+/* Local declarations */
+
+uint16_t frame_crc(const uint8_t *data, uint8_t len);
+void link_timeout();
+void handle_frame(uint8_t type, uint8_t seq, uint8_t *data, uint8_t len);
+bool check_sequence(uint8_t type, uint8_t seq);
+bool restore_blocks(uint8_t type);
+bool live_change(uint8_t seq, uint8_t *data);
+void live_done(uint8_t pin, uint32_t tick);
+task_state_t send_slot_frames(task_t *t);
+task_state_t send_image_frames(task_t *t);
+void image_restored();
+void send_state(uint8_t seq);
+
+
+/* Definitions */
+
+void frame_begin() {
+    upload_active = false;
+    eeprom_restore_abort();
+    serial_set_binary(true);
+    sched_add(&link_timer, link_timeout, BIN_TIMEOUT, 0);
+}
+
+void frame_update() {
+    if (live_waiting == 0) return;
+
+    // Link went back to ASCII, nobody to confirm to
+    if (!serial_binary()) { live_waiting = 0; return; }
+
+    for (uint8_t i = 0; i < NUM_PINS; i++) {
+        if (!(live_waiting & _BV(i)) || active_pins[i].pending) continue;
+
+        // Never block the loop, try again on the next pass
+        if (serial_tx_free() < FRAME_MAX_SIZE) return;
+
+        live_done(i, pin_apply_tick(active_pins, i));
+    }
+}
+
+void frame_process(uint8_t *buf, uint8_t len) {
+    int16_t dec_len = cobs_decode(buf, len, buf);
+
+    // Type, sequence number and CRC at least
+    if (dec_len < 4) {
+        serial_count(LINK_CRC);
+        frame_nak(dec_len >= 2 ? buf[1] : 0, NAK_CRC);
+        return;
+    }
+
+    uint16_t crc = buf[dec_len - 2] | (buf[dec_len - 1] << 8);
+
+    if (frame_crc(buf, dec_len - 2) != crc) {
+        serial_count(LINK_CRC);
+        frame_nak(buf[1], NAK_CRC);
+        return;
+    }
+
+    // Link is alive
+    sched_add(&link_timer, link_timeout, BIN_TIMEOUT, 0);
+
+    handle_frame(buf[0], buf[1], buf + 2, dec_len - 4);
+}
+
+void frame_send(uint8_t type, uint8_t seq, const void *data, uint8_t len) {
+    uint16_t crc;
+    uint8_t enc_len;
+
+    if (len > FRAME_MAX_DATA) return;
+
+    tx_frame[0] = type;
+    tx_frame[1] = seq;
+    memcpy(tx_frame + 2, data, len);
+
+    crc = frame_crc(tx_frame, len + 2);
+    tx_frame[len + 2] = crc & 0xFF;
+    tx_frame[len + 3] = crc >> 8;
+
+    enc_len = cobs_encode(tx_frame, len + 4, tx_encoded);
+
+    for (uint8_t i = 0; i < enc_len; i++) serial_write_c(tx_encoded[i]);
+    serial_write_c(0);
+}
+
+void frame_nak(uint8_t seq, frame_nak_t reason) {
+    uint8_t data[2] = { reason, expected_seq };
+
+    frame_send(FR_NAK, seq, data, reason == NAK_SEQ ? 2 : 1);
+}
+
+uint16_t frame_crc(const uint8_t *data, uint8_t len) {
+    uint16_t crc = 0xFFFF;
+
+    for (uint8_t i = 0; i < len; i++) crc = _crc_xmodem_update(crc, data[i]);
+
+    return crc;
+}
+
+void link_timeout() {
+    // Host is gone, the next one will start in ASCII
+    telemetry_stop();
+    eeprom_restore_abort();
+    serial_set_binary(false);
+}
+
+void handle_frame(uint8_t type, uint8_t seq, uint8_t *data, uint8_t len) {
+    uint8_t reply[FRAME_MAX_DATA];
+
+    if (!check_sequence(type, seq)) return;
+
+    // ram_vars holds part of an image until the restore is over,
+    // nothing may read the library or change the outputs from it
+    if (eeprom_restoring() && restore_blocks(type)) { frame_nak(seq, NAK_BUSY); return; }
+
+    switch (type) {
+        case FR_PING:
+            if (len != 0) break;
+
+            serial_baud_confirm();
+
+            reply[0] = BIN_VERSION;
+            frame_send(FR_PONG, seq, reply, 1);
+            return;
+
+        case FR_ASCII:
+            if (len != 0) break;
+
+            reply[0] = BIN_VERSION;
+            frame_send(FR_PONG, seq, reply, 1);
+
+            sched_cancel(&link_timer);
+            telemetry_stop();
+            eeprom_restore_abort();
+            serial_set_binary(false);
+            return;
+
+        case FR_GET_INFO: {
+            if (len != 0) break;
+
+            uint16_t serial = eeprom_get_serial();
+
+            memcpy(reply, &serial, sizeof(uint16_t));
+            reply[2] = eeprom_get_default_slot();
+            reply[3] = NUM_SLOTS;
+            reply[4] = eeprom_get_used_slots();
+
+            frame_send(FR_INFO, seq, reply, 5);
+            return;
+        }
+
+        case FR_GET_SLOTS:
+            if (len != 0) break;
+
+            // A single dump at a time
+            if (serial_task_running()) { frame_nak(seq, NAK_BUSY); return; }
+
+            dump_seq = seq;
+            dump_first = 0;
+            dump_last = eeprom_get_used_slots();
+            dump_count = true;
+            serial_start_task(send_slot_frames);
+            return;
+
+        case FR_GET_SLOT:
+            if (len != 1 || data[0] >= eeprom_get_used_slots()) break;
+
+            if (serial_task_running()) { frame_nak(seq, NAK_BUSY); return; }
+
+            dump_seq = seq;
+            dump_first = data[0];
+            dump_last = data[0] + 1;
+            dump_count = false;
+            serial_start_task(send_slot_frames);
+            return;
+
+        case FR_GET_HASHES: {
+            if (len != 0) break;
+
+            uint8_t num_slots = eeprom_get_used_slots();
+
+            reply[0] = num_slots;
+
+            for (uint8_t i = 0; i < num_slots; i++) {
+                uint16_t crc = eeprom_get_slot_crc(i);
+                memcpy(reply + 1 + 2 * i, &crc, sizeof(uint16_t));
+            }
+
+            frame_send(FR_HASHES, seq, reply, 1 + 2 * num_slots);
+            return;
+        }
+
+        case FR_SLOT_COUNT:
+            if (len != 1 || data[0] > NUM_SLOTS) break;
+
+            eeprom_restore_abort();
+            upload_start(data[0]);
+            upload_active = true;
+            expected_seq = seq + 1;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+
+        case FR_SYNC_COUNT:
+            if (len != 1 || data[0] > NUM_SLOTS) break;
+
+            eeprom_restore_abort();
+            upload_sync(data[0]);
+            upload_active = true;
+            expected_seq = seq + 1;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+
+        case FR_SLOT: {
+            if (len < 1 || len > SLOT_DATA_SIZE) break;
+
+            char name[EE_SLOT_NAME_SIZE];
+
+            // Name doesn't need to be terminated
+            memset(name, 0, EE_SLOT_NAME_SIZE);
+            memcpy(name, data + 1, len - 1);
+            name[EE_SLOT_NAME_SIZE - 1] = '\0';
+
+            if (!upload_slot(data[0], name)) break;
+
+            expected_seq++;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+        }
+
+        case FR_PWM: {
+            if (len != PWM_DATA_SIZE) break;
+
+            memcpy(reply, data + 2, sizeof(pwm_t));  // Aligned copy
+
+            // Slots are put on the outputs as they are, out of range
+            // values would reach set_pin_config()
+            pwm_t *pwm = (pwm_t *)reply;
+            if (!pin_values_valid(pwm->mode, pwm->frq, pwm->dty, pwm->phs)) break;
+
+            if (!upload_pwm(data[0], data[1], pwm)) break;
+
+            expected_seq++;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+        }
+
+        case FR_TELEMETRY: {
+            if (len != 2) break;
+
+            uint16_t period;
+            memcpy(&period, data, sizeof(uint16_t));
+
+            if (period == 0) telemetry_stop();
+            else telemetry_start(seq, period);
+            return;
+        }
+
+        case FR_GET_IMAGE:
+            if (len != 0) break;
+
+            // Half an image would be sent otherwise
+            if (serial_task_running()) { frame_nak(seq, NAK_BUSY); return; }
+
+            dump_seq = seq;
+            serial_start_task(send_image_frames);
+            return;
+
+        case FR_IMAGE_SIZE: {
+            if (len != 2) break;
+
+            uint16_t size;
+            memcpy(&size, data, sizeof(uint16_t));
+
+            // Images from another firmware version may be laid out differently
+            if (size != sizeof(eeprom_t)) break;
+
+            // Pending writes must be over first, the host tries again
+            if (serial_task_running() || !eeprom_restore_begin()) { frame_nak(seq, NAK_BUSY); return; }
+
+            // They would read the partial image on their next step
+            if (morph_running()) morph_stop();
+            if (playlist_running() != -1) playlist_stop();
+            if (slow_running != -1) slow_stop();
+
+            image_next = 0;
+            upload_active = true;
+            expected_seq = seq + 1;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+        }
+
+        case FR_IMAGE_DATA: {
+            if (len < 3 || !eeprom_restoring()) break;
+
+            uint16_t offset;
+            memcpy(&offset, data, sizeof(uint16_t));
+
+            if (offset != image_next || offset + len - 2 > sizeof(eeprom_t)) break;
+
+            eeprom_restore_chunk(offset, data + 2, len - 2);
+            image_next += len - 2;
+
+            expected_seq++;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+        }
+
+        case FR_IMAGE_CRC: {
+            if (len != 2 || !eeprom_restoring() || image_next != sizeof(eeprom_t)) break;
+
+            uint16_t crc;
+            memcpy(&crc, data, sizeof(uint16_t));
+
+            if (!eeprom_restore_end(crc)) break;
+
+            image_restored();
+
+            expected_seq++;
+            frame_send(FR_ACK, seq, NULL, 0);
+            return;
+        }
+
+        case FR_ACTIVATE: {
+            if (len != 2 || data[0] > 1) break;
+
+            int8_t idx = data[1];
+
+            if (idx < -1 || idx >= (data[0] == 0 ? eeprom_get_used_slots() : SLOW_NUM_ENTRIES)) break;
+
+            if (data[0] == 0) activate_slot(idx);
+            else slow_start(idx);
+
+            send_state(seq);
+            return;
+        }
+
+        case FR_GET_STATUS:
+            if (len != 0) break;
+
+            send_state(seq);
+            return;
+
+        case FR_GET_LINK:
+            if (len > 1 || (len == 1 && data[0] > 1)) break;
+
+            for (uint8_t i = 0; i < LINK_COUNT; i++) {
+                uint16_t count = serial_get_count(i);
+                memcpy(reply + 2 * i, &count, sizeof(uint16_t));
+            }
+
+            if (len == 1 && data[0] == 1) serial_clear_counts();
+
+            frame_send(FR_LINK, seq, reply, 2 * LINK_COUNT);
+            return;
+
+        case FR_LIVE: {
+            if (len != LIVE_DATA_SIZE || data[0] >= NUM_PINS || data[1] > ON_MODE) break;
+
+            uint16_t frq, dty;
+            int16_t phs;
+            memcpy(&frq, data + 2, sizeof(uint16_t));
+            memcpy(&dty, data + 4, sizeof(uint16_t));
+            memcpy(&phs, data + 6, sizeof(int16_t));
+
+            // A frequency of 0 would divide by zero in set_pin_config()
+            if (frq < 1 || frq > PWM_MAX_FRQ || dty > 100 || phs < -99 || phs > 99) break;
+
+            if (!live_change(seq, data)) frame_nak(seq, NAK_BUSY);
+            return;
+        }
+
+        default:
+            frame_nak(seq, NAK_TYPE);
+            return;
+    }
+
+    frame_nak(seq, NAK_FORMAT);
+}
+
+bool restore_blocks(uint8_t type) {
+    return type == FR_GET_INFO || type == FR_GET_SLOTS || type == FR_GET_SLOT ||
+           type == FR_GET_HASHES || type == FR_SLOT || type == FR_PWM ||
+           type == FR_GET_IMAGE || type == FR_ACTIVATE || type == FR_LIVE;
+}
+
+bool check_sequence(uint8_t type, uint8_t seq) {
+    bool count = type == FR_SLOT_COUNT || type == FR_SYNC_COUNT || type == FR_IMAGE_SIZE;
+
+    if (!count && type != FR_SLOT && type != FR_PWM &&
+        type != FR_IMAGE_DATA && type != FR_IMAGE_CRC) return true;
+
+    if (upload_active) {
+        // Already applied, its ACK got lost
+        if ((uint8_t)(expected_seq - seq - 1) < BIN_WINDOW) {
+            frame_send(FR_ACK, expected_seq - 1, NULL, 0);
+            return false;
+        }
+
+        // Anything after a lost frame
+        if (!count && seq != expected_seq) {
+            frame_nak(seq, NAK_SEQ);
+            return false;
+        }
+    }
+    // Slots and PWMs before the count got through
+    else if (!count) {
+        frame_nak(seq, NAK_SEQ);
+        return false;
+    }
+
+    return true;
+}
+
+bool live_change(uint8_t seq, uint8_t *data) {
+    uint8_t pin = data[0];
+    pin_mode mode = data[1];
+    uint16_t frq, dty;
+    int16_t phs;
+
+    memcpy(&frq, data + 2, sizeof(uint16_t));
+    memcpy(&dty, data + 4, sizeof(uint16_t));
+    memcpy(&phs, data + 6, sizeof(int16_t));
+
+    if (active_pins[pin].pending) return false;
+
+    // They would overwrite the change on their next step
+    if (morph_running()) morph_stop();
+    if (playlist_running() != -1) playlist_stop();
+    if (slow_running != -1) slow_stop();
+
+    live_seq[pin] = seq;
+
+    if (mode == PWM_MODE && active_pins[pin].mode == PWM_MODE) {
+        // Keeps the output glitch free, frame_update confirms it
+        queue_pin_config(active_pins, pin, frq, dty, phs);
+        live_waiting |= _BV(pin);
+    }
+    else {
+        // The counter is only used in PWM mode, so the new timing
+        // is in place before the pin starts toggling, and a pin
+        // leaving PWM mode stops toggling before it's touched
+        if (mode != PWM_MODE) set_pin_mode(active_pins, pin, mode);
+
+        set_pin_config(active_pins, pin, frq, dty);
+        set_pin_phase(active_pins, pin, phs);
+        set_pin_mode(active_pins, pin, mode);
+
+        live_done(pin, pwm_ticks());
+    }
+
+    return true;
+}
+
+void live_done(uint8_t pin, uint32_t tick) {
+    uint8_t data[5];
+
+    data[0] = pin;
+    memcpy(data + 1, &tick, sizeof(uint32_t));
+
+    frame_send(FR_LIVE_DONE, live_seq[pin], data, 5);
+    live_waiting &= ~_BV(pin);
+}
+
+task_state_t send_slot_frames(task_t *t) {
+    /*
+       Replies with the request's sequence number:
+           FR_SLOT_COUNT | FR_REPLY: X (only to FR_GET_SLOTS)
+           loop X times:
+               FR_SLOT | FR_REPLY: SI, SN
+               loop 8 times:
+                   FR_PWM | FR_REPLY: SI, PI, pwm_t
+
+       Each frame waits until it fits in the TX buffer
+    */
+
+    static uint8_t i, j;
+    static slot_t to_send;
+    uint8_t data[PWM_DATA_SIZE];
+
+    TASK_BEGIN(t);
+
+    if (dump_count) {
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+        frame_send(FR_SLOT_COUNT | FR_REPLY, dump_seq, &dump_last, 1);
+    }
+
+    for (i = dump_first; i < dump_last; i++) {
+        eeprom_get_slot(i, &to_send);
+
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+        data[0] = i;
+        memcpy(data + 1, to_send.name, EE_SLOT_NAME_SIZE);
+        frame_send(FR_SLOT | FR_REPLY, dump_seq, data, SLOT_DATA_SIZE);
+
+        for (j = 0; j < NUM_PINS; j++) {
+            TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+            data[0] = i;
+            data[1] = j;
+            memcpy(data + 2, &to_send.pwms[j], sizeof(pwm_t));
+            frame_send(FR_PWM | FR_REPLY, dump_seq, data, PWM_DATA_SIZE);
+        }
+    }
+
+    TASK_END(t);
+}
+
+task_state_t send_image_frames(task_t *t) {
+    /*
+       Replies with the request's sequence number:
+           FR_IMAGE_SIZE | FR_REPLY: S
+           loop until S bytes are sent:
+               FR_IMAGE_DATA | FR_REPLY: O, up to IMAGE_CHUNK bytes
+           FR_IMAGE_CRC | FR_REPLY: C
+
+       S = Image size, sizeof(eeprom_t)
+       O = Offset of the first byte
+       C = CRC of the bytes sent, same as frames
+
+       Each frame waits until it fits in the TX buffer
+    */
+
+    static uint16_t offset;
+    static uint16_t crc;
+    uint8_t data[FRAME_MAX_DATA];
+    uint8_t len;
+
+    TASK_BEGIN(t);
+
+    TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+    offset = sizeof(eeprom_t);
+    frame_send(FR_IMAGE_SIZE | FR_REPLY, dump_seq, &offset, sizeof(uint16_t));
+
+    crc = 0xFFFF;
+    offset = 0;
+
+    while (offset < sizeof(eeprom_t)) {
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+
+        len = sizeof(eeprom_t) - offset < IMAGE_CHUNK ? sizeof(eeprom_t) - offset : IMAGE_CHUNK;
+
+        memcpy(data, &offset, sizeof(uint16_t));
+        eeprom_read_image(offset, data + 2, len);
+
+        for (uint8_t i = 0; i < len; i++) crc = _crc_xmodem_update(crc, data[2 + i]);
+
+        frame_send(FR_IMAGE_DATA | FR_REPLY, dump_seq, data, len + 2);
+        offset += len;
+    }
+
+    TASK_WAIT_UNTIL(t, serial_tx_free() >= FRAME_MAX_SIZE);
+    frame_send(FR_IMAGE_CRC | FR_REPLY, dump_seq, &crc, sizeof(uint16_t));
+
+    TASK_END(t);
+}
+
+void image_restored() {
+    // Same as booting with the new image
+    set_brightness(eeprom_get_brightness());
+    activate_slot(eeprom_get_default_slot());
+}
+
+void send_state(uint8_t seq) {
+    status_t status;
+
+    telemetry_get_status(&status);
+    frame_send(FR_STATUS, seq, &status, sizeof(status_t));
+}
@@ -6,17 +6,192 @@
  */
 
 #include "sys/io/serial_control.h"
+
+#include <ctype.h>
+#include <util/atomic.h>
+
 #include "sys/eeprom_control.h"
 #include "sys/menu/list_menu.h"
+#include "sys/menu/slow_menu.h"
+#include "sys/playlist_control.h"
+#include "sys/morph_control.h"
+#include "sys/event_control.h"
+#include "sys/batch_control.h"
+#include "common/cobs.h"
 #include "common/config.h"
 #include "common/util.h"
+#include "common/task.h"
 #include "pwm/pwm_gen.h"
 #include "pwm/virtual_PWM.h"
+#include "sys/menu_control.h"
+#include "sys/io/frame_control.h"
+#include "sys/scheduler.h"
+
+#if (SER_RX_LINES & (SER_RX_LINES - 1)) != 0 || SER_RX_LINES < 2
+    #error "SER_RX_LINES must be a power of two, at least 2"
+#endif
+
+#define RX_MASK (SER_RX_LINES - 1)
 
-char rx_buf[SER_BUFS_SIZE];
+#if SER_MAX_FIELDS > 8
+    #error "SER_MAX_FIELDS must be at most 8"
+#endif
+
+// Numbers are up to 9 digits long, so they fit in an int32_t
+#define RX_MAX_VALUE 999999999L
+
+/**
+ * @brief What the field being received looks like so far
+ */
+typedef enum rx_num_t {
+    NUM_EMPTY,  /**< Nothing received */
+    NUM_MINUS,  /**< Just a minus sign */
+    NUM_POS,  /**< Positive number */
+    NUM_NEG,  /**< Negative number */
+    NUM_NONE  /**< Not a number */
+} rx_num_t;
+
+// The interrupt fills line rx_w_ptr while the parser works on line rx_r_ptr,
+// so a line is never overwritten while it's being parsed. Pointers run
+// freely, like in the event queue
+static char rx_lines[SER_RX_LINES][SER_BUFS_SIZE];
+static uint8_t rx_lens[SER_RX_LINES];  // Length of binary frames, 0 for ASCII lines
+
+// ASCII lines are split into fields and their numbers converted as
+// they arrive, so they're ready to be executed once the '\n' does
+static uint8_t rx_num_fields[SER_RX_LINES];
+static uint8_t rx_starts[SER_RX_LINES][SER_MAX_FIELDS];  // Each field ends with a zero
+static int32_t rx_values[SER_RX_LINES][SER_MAX_FIELDS];
+static uint8_t rx_numeric[SER_RX_LINES];  // Bit i is set if field i is a number
+static bool rx_too_long[SER_RX_LINES];
+static bool rx_tagged[SER_RX_LINES];  // Starts with "#T,", fields come after it
+static uint8_t rx_field = 0;  // Field being received
+static int32_t rx_value = 0;
+static rx_num_t rx_num = NUM_EMPTY;
+static volatile bool binary_mode = false;
+static volatile uint8_t rx_r_ptr = 0;
+static volatile uint8_t rx_w_ptr = 0;
 uint8_t rx_pos = 0;
 bool rx_in_progress = false;
-char tx_buf[SER_BUFS_SIZE];
+bool rx_dropping = false;  // No free line buffer, current line is ignored
+static int8_t drop_field;  // Field of the line being dropped, the tag is -1
+static uint8_t drop_cmd;
+static uint8_t drop_head[3];  // Enough of a dropped frame to decode its sequence number
+
+// Commands dropped for lack of a buffer, replied BUSY by serial_update:
+// the command char of ASCII lines, the sequence number of frames
+static volatile uint8_t rej_ids[SER_RX_LINES];
+static volatile uint8_t rej_r_ptr = 0;
+static volatile uint8_t rej_w_ptr = 0;
+
+#if (SER_TX_SIZE & (SER_TX_SIZE - 1)) != 0 || SER_TX_SIZE > 128
+    #error "SER_TX_SIZE must be a power of two, up to 128"
+#endif
+
+#define TX_MASK (SER_TX_SIZE - 1)
+
+// "#T," of tagged replies
+#define TAG_LENGTH (SER_TAG_SIZE + 2)
+
+// "^!,h,I", then ",65535" per bin and '\n'
+#define HIST_LINE_SIZE (TAG_LENGTH + 6 + LAT_HIST_BINS * 6 + 1)
+
+#if HIST_LINE_SIZE > SER_TX_SIZE
+    #error "Histogram lines don't fit in the TX buffer"
+#endif
+
+// "^!,k,XX", then ",65535" per slot and '\n'
+#define HASH_LINE_SIZE (TAG_LENGTH + 7 + NUM_SLOTS * 6 + 1)
+
+#if HASH_LINE_SIZE > UINT8_MAX
+    #error "Hash lines are too long"
+#endif
+
+// "^!,q", then ",65535" per counter and '\n'
+#define LINK_LINE_SIZE (TAG_LENGTH + 4 + LINK_COUNT * 6 + 1)
+
+#if LINK_LINE_SIZE > SER_TX_SIZE
+    #error "Link counter lines don't fit in the TX buffer"
+#endif
+
+// Same scheme as the event queue, with the main loop as producer and
+// the UDRE interrupt as consumer
+static volatile uint8_t tx_ring[SER_TX_SIZE];
+static volatile uint8_t tx_r_ptr = 0;
+static volatile uint8_t tx_w_ptr = 0;
+static volatile bool tx_active = false;  // Something has been sent since the last flush
+
+// Baud rates offered to the host, the first one is used at boot
+static const uint32_t bauds[] = { SER_BAUD, SER_FAST_BAUDS };
+#define NUM_BAUDS (sizeof(bauds) / sizeof(bauds[0]))
+
+static bool baud_probing = false;
+static sched_timer_t baud_timer;
+static volatile uint8_t rx_errors = 0;  // Since the last check
+
+static volatile uint16_t link_counts[LINK_COUNT];
+
+uint8_t rx_num_slots;
+uint8_t rx_slot_idx;
+slot_t rx_slot;  // Only the slot being received, each one is stored as soon as it's complete
+uint8_t rx_pwm_idx;
+
+static task_t task;
+static task_fn_t running_task = NULL;  // Long reply being sent, if any
+
+// Command whose effect on the outputs is being timed
+static bool effect_waiting = false;
+static uint16_t effect_eol;
+static uint16_t effect_apply;
+static bool effect_morph;  // Ends with the morph's first step instead
+
+// Reply line being written to the TX buffer
+static char reply_tag[SER_TAG_SIZE + 1] = "";  // Echoed in every reply line, if not empty
+static char task_tag[SER_TAG_SIZE + 1];  // Tag of the request the running task replies to
+static bool line_sent;  // Some reply has been sent for the current request
+static uint8_t line_len;
+static uint8_t line_size;  // Longest line allowed, '\n' included
+static bool line_cut;  // Some field didn't fit and was left out
+
+
+/* Local declarations */
+
+void track_effect();
+void track_morph();
+void parse_line(uint8_t line);
+void run_line(uint8_t line);
+bool check_tag(const char *tag);
+void rx_reset();
+void rx_start_line(uint8_t line);
+void rx_add_c(char c);
+void rx_end_field(uint8_t line);
+void rx_drop_c(char c);
+void reject_push(uint8_t id);
+char *rx_text(uint8_t line, uint8_t field);
+int32_t rx_number(uint8_t line, uint8_t field);
+bool rx_in_range(uint8_t line, uint8_t field, int32_t min, int32_t max);
+bool check_args(uint8_t line, const char *format);
+void set_baud(uint8_t idx);
+void baud_check();
+void send_bauds();
+void change_baud(uint32_t baud);
+void send_binary();
+void send_hashes();
+void commit_batch();
+void send_link();
+void send_active();
+void line_begin(const char *cmd, uint8_t size);
+void send_reply(const char *status);
+void send_error(uint8_t code);
+void set_reply_tag(const char *tag);
+void line_field(const char *str, uint8_t len);
+void line_u(uint32_t num);
+void line_i(int16_t num);
+void line_s(const char *str);
+bool line_end();
+
+
+/* Definitions */
 
 void serial_setup() {
     cli();
@@ -50,10 +225,53 @@ bool serial_tx_available() {
     return (UCSR0A & (1 << UDRE0));
 }
 
-void serial_write_c(char data) {
-    while (!serial_tx_available());
+bool serial_put_c(char data) {
+    uint8_t w = tx_w_ptr;
 
-    UDR0 = data;
+    if ((uint8_t)(w - tx_r_ptr) == SER_TX_SIZE) return false;
+
+    tx_ring[w & TX_MASK] = data;
+    tx_w_ptr = w + 1;
+
+    UCSR0B |= (1 << UDRIE0);
+
+    return true;
+}
+
+uint8_t serial_tx_free() {
+    return SER_TX_SIZE - (uint8_t)(tx_w_ptr - tx_r_ptr);
+}
+
+void serial_flush() {
+    while (tx_r_ptr != tx_w_ptr);
+
+    // TXC0 is never set if nothing has been sent
+    if (tx_active) {
+        while (!(UCSR0A & (1 << TXC0)));
+        tx_active = false;
+    }
+}
+
+void serial_tx_next() {
+    uint8_t r = tx_r_ptr;
+
+    if (r == tx_w_ptr) {
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+
+    // TXC0 is cleared by writing a one, flags must be written as zeros
+    UCSR0A = (UCSR0A & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);
+    UDR0 = tx_ring[r & TX_MASK];
+    tx_r_ptr = r + 1;
+    tx_active = true;
+}
+
+void serial_write_c(char data) {
+    while (!serial_put_c(data)) {
+        // The interrupt can't drain the buffer if interrupts are off
+        if (!(SREG & (1 << SREG_I)) && serial_tx_available()) serial_tx_next();
+    }
 }
 
 void serial_write_s(char *data) {
@@ -79,10 +297,8 @@ void serial_write_n(int data) {
 }
 
 void serial_writeln_c(char data) {
-    while (!serial_tx_available());
-    UDR0 = data;
-    while (!serial_tx_available());
-    UDR0 = '\n';
+    serial_write_c(data);
+    serial_write_c('\n');
 }
 
 void serial_writeln_s(char *data) {
@@ -111,37 +327,591 @@ void serial_writeln_n(int data) {
 }
 
 bool process_serial() {
+    // Status has to be read before the data
+    const uint8_t status = UCSR0A;
+
+    if (status & (_BV(FE0) | _BV(DOR0) | _BV(UPE0))) {
+        if (rx_errors < UINT8_MAX) rx_errors++;
+
+        if (status & _BV(FE0)) serial_count(LINK_FRAMING);
+        if (status & _BV(DOR0)) serial_count(LINK_OVERRUN);
+        if (status & _BV(UPE0)) serial_count(LINK_PARITY);
+    }
+
     // No need to check if RX is available because we use interrupts
     const unsigned char c = serial_read();
 
-    if (rx_in_progress) {
-        switch (c) {
-            case '\r':
-                break;
-            case SER_END_CHAR:
-                rx_buf[rx_pos] = '\0';
-                rx_pos = 0;
-                rx_in_progress = false;
-                return true;
-            default:
-                rx_buf[rx_pos] = c;
-                rx_pos = limit(++rx_pos, 0, SER_BUFS_SIZE - 1);
-                break;
+    uint8_t line = rx_w_ptr & RX_MASK;
+    char *rx_buf = rx_lines[line];
+
+    if (binary_mode) {
+        if (c != 0) {
+            // Start of a frame
+            if (rx_pos == 0 && !rx_in_progress) {
+                rx_in_progress = true;
+                rx_dropping = (uint8_t)(rx_w_ptr - rx_r_ptr) == SER_RX_LINES;
+            }
+
+            if (rx_dropping) {
+                if (rx_pos < sizeof(drop_head)) drop_head[rx_pos++] = c;
+            }
+            // Too long frames are cut, and fail the CRC check
+            else if (rx_pos < SER_BUFS_SIZE) rx_buf[rx_pos++] = c;
+
+            return false;
         }
+
+        if (!rx_in_progress) return false;  // Empty frame
+
+        rx_in_progress = false;
+
+        if (rx_dropping) {
+            reject_push(cobs_byte(drop_head, rx_pos, 1));
+            rx_pos = 0;
+            serial_count(LINK_DROPPED);
+            return false;
+        }
+
+        rx_lens[line] = rx_pos;
+        rx_pos = 0;
+        rx_w_ptr++;
+        return true;
     }
-    else if (c == SER_START_CHAR) {
+
+    // A start char always begins a new line, so a line that lost its
+    // end to noise doesn't swallow the next command
+    if (c == SER_START_CHAR) {
         rx_in_progress = true;
+        rx_pos = 0;
+        rx_dropping = (uint8_t)(rx_w_ptr - rx_r_ptr) == SER_RX_LINES;
+
+        if (!rx_dropping) rx_start_line(line);
+        else {
+            drop_field = 0;
+            drop_cmd = 0;
+        }
+
+        return false;
+    }
+
+    // Buffer belongs to the parser
+    if (!rx_in_progress || rx_dropping) {
+        if (!rx_in_progress) return false;
+
+        if (c == SER_END_CHAR) {
+            rx_in_progress = false;
+            rx_pos = 0;
+            reject_push(drop_cmd);  // Every buffer was still waiting to be parsed
+            serial_count(LINK_DROPPED);
+        }
+        else rx_drop_c(c);
+
+        return false;
+    }
+
+    switch (c) {
+        case '\r':
+            break;
+        case SER_END_CHAR:
+            rx_in_progress = false;
+            rx_end_field(line);
+
+            rx_buf[rx_pos] = '\0';
+            rx_pos = 0;
+            rx_num_fields[line] = rx_field + 1;
+            rx_lens[line] = 0;
+            rx_w_ptr++;  // Hand the line over to the parser
+            return true;
+        case ',':
+            // End of the tag, fields start after it
+            if (rx_tagged[line] && rx_field == 0 && rx_starts[line][0] == 0) {
+                if (rx_pos < SER_BUFS_SIZE - 1) rx_buf[rx_pos++] = '\0';
+                else rx_too_long[line] = true;
+
+                rx_starts[line][0] = rx_pos;
+                rx_value = 0;
+                rx_num = NUM_EMPTY;
+                break;
+            }
+
+            if (rx_field < SER_MAX_FIELDS - 1) {
+                rx_end_field(line);
+
+                if (rx_pos < SER_BUFS_SIZE - 1) rx_buf[rx_pos++] = '\0';
+                else rx_too_long[line] = true;
+
+                rx_field++;
+                rx_starts[line][rx_field] = rx_pos;
+                rx_value = 0;
+                rx_num = NUM_EMPTY;
+                break;
+            }
+            // fall through, kept in the last field
+        default:
+            if (rx_pos == 0 && c == SER_TAG_CHAR) rx_tagged[line] = true;
+
+            // One char is kept for the final zero
+            if (rx_pos < SER_BUFS_SIZE - 1) rx_buf[rx_pos++] = c;
+            else rx_too_long[line] = true;
+
+            rx_add_c(c);
+            break;
     }
 
     return false;
 }
 
+void rx_start_line(uint8_t line) {
+    rx_field = 0;
+    rx_value = 0;
+    rx_num = NUM_EMPTY;
+
+    rx_starts[line][0] = 0;
+    rx_numeric[line] = 0;
+    rx_too_long[line] = false;
+    rx_tagged[line] = false;
+}
+
+void rx_add_c(char c) {
+    if (c == '-' && rx_num == NUM_EMPTY) {
+        rx_num = NUM_MINUS;
+        return;
+    }
+
+    if (c < '0' || c > '9' || rx_num == NUM_NONE || rx_value > RX_MAX_VALUE / 10) {
+        rx_num = NUM_NONE;
+        return;
+    }
+
+    rx_value = rx_value * 10 + (c - '0');
+
+    if (rx_num == NUM_EMPTY) rx_num = NUM_POS;
+    else if (rx_num == NUM_MINUS) rx_num = NUM_NEG;
+}
+
+void rx_end_field(uint8_t line) {
+    if (rx_num != NUM_POS && rx_num != NUM_NEG) return;
+
+    rx_values[line][rx_field] = rx_num == NUM_NEG ? -rx_value : rx_value;
+    rx_numeric[line] |= _BV(rx_field);
+}
+
+void rx_drop_c(char c) {
+    // Only the command is kept, so the host knows which one to resend
+    if (rx_pos == 0 && c == SER_TAG_CHAR) drop_field = -1;
+    else if (c == ',') drop_field++;
+    else if (drop_field == 1 && drop_cmd == 0) drop_cmd = c;
+
+    if (rx_pos < UINT8_MAX) rx_pos++;
+}
+
+void reject_push(uint8_t id) {
+    // Any further ones are only counted as LINK_DROPPED
+    if ((uint8_t)(rej_w_ptr - rej_r_ptr) == SER_RX_LINES) return;
+
+    rej_ids[rej_w_ptr & RX_MASK] = id;
+    rej_w_ptr++;
+}
+
+void serial_reject() {
+    rx_w_ptr--;  // Take the line back, it won't be parsed
+
+    uint8_t line = rx_w_ptr & RX_MASK;
+
+    if (binary_mode) reject_push(cobs_byte((uint8_t *)rx_lines[line], rx_lens[line], 1));
+    else reject_push(rx_num_fields[line] >= 2 ? rx_text(line, 1)[0] : 0);
+
+    serial_count(LINK_DROPPED);
+}
+
+void serial_count(link_counter_t counter) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (link_counts[counter] < UINT16_MAX) link_counts[counter]++;
+    }
+}
+
+uint16_t serial_get_count(link_counter_t counter) {
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = link_counts[counter];
+    }
+
+    return count;
+}
+
+void serial_clear_counts() {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < LINK_COUNT; i++) link_counts[i] = 0;
+    }
+}
+
+void serial_update() {
+    while (rej_r_ptr != rej_w_ptr) {
+        char id = rej_ids[rej_r_ptr & RX_MASK];
+        rej_r_ptr++;
+
+        // Its tag was lost along with the line
+        set_reply_tag("");
+
+        if (binary_mode) frame_nak(id, NAK_BUSY);
+        else {
+            line_begin("BUSY", SER_BUFS_SIZE);
+            if (id != '\0') line_field(&id, 1);
+            line_end();
+        }
+    }
+
+    if (running_task != NULL) {
+        set_reply_tag(task_tag);
+        if (running_task(&task) == TASK_DONE) running_task = NULL;
+        set_reply_tag("");
+    }
+
+    frame_update();
+
+    // Changes made directly take effect right away, staged and pending
+    // ones when the interrupt applies them
+    if (effect_waiting && !pins_pending(active_pins)) {
+        uint16_t end = pins_apply_time();
+        bool applied = end != effect_apply;
+
+        // A morph only changes the outputs once its timer queues the
+        // first step, or once it loads the slot if nothing was queued
+        if (applied || !effect_morph || !morph_running()) {
+            if (!applied) end = event_now();
+
+            event_record_latency(LAT_HIST_EFFECT, end - effect_eol);
+            effect_waiting = false;
+        }
+    }
+}
+
+void track_effect() {
+    effect_eol = event_get_time();
+    effect_apply = pins_apply_time();
+    effect_morph = false;
+    effect_waiting = true;
+}
+
+void track_morph() {
+    track_effect();
+    effect_morph = true;
+}
+
+bool serial_start_task(task_fn_t fn) {
+    if (running_task != NULL) return false;
+
+    TASK_INIT(&task);
+    running_task = fn;
+    strcpy(task_tag, reply_tag);
+    line_sent = true;  // The task replies
+
+    return true;
+}
+
+void serial_set_binary(bool binary) {
+    // A half received line or frame is dropped
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        binary_mode = binary;
+        rx_reset();
+    }
+}
+
+void rx_reset() {
+    rx_in_progress = false;
+    rx_pos = 0;
+}
+
+void set_baud(uint8_t idx) {
+    uint16_t ubrr = SER_UBRR_OF(bauds[idx]);
+
+    // Whatever is still queued would be sent at the new rate
+    serial_flush();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        UBRR0H = (unsigned char)(ubrr >> 8);
+        UBRR0L = (unsigned char)(ubrr);
+
+        rx_reset();
+        rx_errors = 0;
+    }
+}
+
+void serial_baud_confirm() {
+    if (!baud_probing) return;
+
+    baud_probing = false;
+    sched_add(&baud_timer, baud_check, SER_ERROR_CHECK, SER_ERROR_CHECK);
+}
+
+void baud_check() {
+    uint8_t errors;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        errors = rx_errors;
+        rx_errors = 0;
+    }
+
+    // No probe in time, or the link is too noisy for this rate
+    if (baud_probing || errors > SER_MAX_ERRORS) {
+        baud_probing = false;
+        sched_cancel(&baud_timer);
+        set_baud(0);
+    }
+}
+
+bool serial_binary() {
+    return binary_mode;
+}
+
+void upload_start(uint8_t num_slots) {
+    rx_num_slots = num_slots;
+
+    eeprom_delete_all_slots();
+    unload_active_slot();
+    track_effect();
+}
+
+bool serial_task_running() {
+    return running_task != NULL;
+}
+
+void upload_sync(uint8_t num_slots) {
+    rx_num_slots = num_slots;
+    rx_slot_idx = NUM_SLOTS;
+
+    eeprom_truncate_slots(num_slots);
+}
+
+bool upload_slot(uint8_t idx, const char *name) {
+    if (idx >= rx_num_slots || idx >= NUM_SLOTS || idx > eeprom_get_used_slots()) {
+        rx_slot_idx = NUM_SLOTS;  // PWMs are ignored until a valid slot arrives
+        return false;
+    }
+
+    rx_slot_idx = idx;
+
+    memset(&rx_slot, 0, sizeof(slot_t));
+    strncpy(rx_slot.name, name, EE_SLOT_NAME_SIZE - 1);
+
+    return true;
+}
+
+bool upload_pwm(uint8_t slot, uint8_t pin, const pwm_t *pwm) {
+    if (slot != rx_slot_idx || slot >= rx_num_slots || pin >= NUM_PINS) return false;
+
+    memcpy(&rx_slot.pwms[pin], pwm, sizeof(pwm_t));
+    rx_slot.pwms[pin].name[EE_PWM_NAME_SIZE - 1] = '\0';
+
+    // Last PWM, save slot. It's written to the EEPROM in the
+    // background while the next one arrives, skipping unchanged
+    // bytes of overwritten slots
+    if (pin == (NUM_PINS - 1)) {
+        if (slot < eeprom_get_used_slots()) {
+            rx_slot.used = true;
+            eeprom_overwrite_slot(slot, &rx_slot);
+        }
+        else eeprom_new_slot(&rx_slot);
+    }
+
+    return true;
+}
+
+void line_begin(const char *cmd, uint8_t size) {
+    line_len = 3;
+    line_size = size;
+    line_cut = false;
+    line_sent = true;
+
+    serial_write_c(SER_START_CHAR);
+
+    // "#T," before the usual reply
+    if (reply_tag[0] != '\0') {
+        serial_write_c(SER_TAG_CHAR);
+        for (char *c = reply_tag; *c != '\0'; c++, line_len++) serial_write_c(*c);
+        serial_write_c(',');
+        line_len += 2;
+    }
+
+    serial_write_c('!');
+    serial_write_c(',');
+
+    for (; *cmd != '\0'; cmd++, line_len++) serial_write_c(*cmd);
+}
+
+void send_reply(const char *status) {
+    line_begin(status, SER_BUFS_SIZE);
+    line_end();
+}
+
+void send_error(uint8_t code) {
+    char status[5] = "ERR0";
+
+    status[3] += code;
+    serial_count(LINK_ERR1 + code - 1);
+    send_reply(status);
+}
+
+void set_reply_tag(const char *tag) {
+    strcpy(reply_tag, tag);
+}
+
+void line_field(const char *str, uint8_t len) {
+    // Room for the comma and the '\n'
+    if (line_len + len + 2 > line_size) {
+        line_cut = true;
+        return;
+    }
+
+    line_len += len + 1;
+
+    serial_write_c(',');
+    while (len--) serial_write_c(*str++);
+}
+
+void line_u(uint32_t num) {
+    char tmp_s[11];
+
+    if (num <= UINT16_MAX) line_field(tmp_s, utos(num, tmp_s));
+    else line_field(tmp_s, strlen(ultoa(num, tmp_s, 10)));
+}
+
+void line_i(int16_t num) {
+    char tmp_s[7];
+
+    if (num >= 0) {
+        line_field(tmp_s, utos(num, tmp_s));
+    }
+    else {
+        tmp_s[0] = '-';
+        line_field(tmp_s, utos(-(int32_t)num, tmp_s + 1) + 1);
+    }
+}
+
+void line_s(const char *str) {
+    line_field(str, strlen(str));
+}
+
+bool line_end() {
+    serial_write_c('\n');
+    return !line_cut;
+}
+
 void send_handshake()
 {
     // Response: ^!,@\n
 
-    strcpy(tx_buf, "^!,@");
-    serial_writeln_s(tx_buf);
+    line_begin("@", SER_BUFS_SIZE);
+    line_end();
+
+    serial_baud_confirm();  // It's also the probe after a baud rate change
+}
+
+void send_binary()
+{
+    /*
+       Response: ^!,b,V\n
+
+       V = Binary protocol version
+
+       Frames are expected from then on
+    */
+
+    line_begin("b", SER_BUFS_SIZE);
+    line_u(BIN_VERSION);
+    line_end();
+
+    frame_begin();
+}
+
+void send_hashes()
+{
+    /*
+       Response: ^!,k,X,H0,...,HX-1\n
+
+       X = Number of slots
+       HX = Slot hash (see eeprom_get_slot_crc)
+    */
+
+    uint8_t num_slots = eeprom_get_used_slots();
+
+    line_begin("k", HASH_LINE_SIZE);
+    line_u(num_slots);
+
+    for (uint8_t i = 0; i < num_slots; i++) {
+        line_u(eeprom_get_slot_crc(i));
+    }
+
+    line_end();
+}
+
+void send_bauds()
+{
+    /*
+       Response: ^!,r,B0,...,BX-1\n
+
+       BX = Supported baud rate, the first one is used at boot
+    */
+
+    line_begin("r", SER_BUFS_SIZE);
+
+    for (uint8_t i = 0; i < NUM_BAUDS; i++) {
+        line_u(bauds[i]);
+    }
+
+    line_end();
+}
+
+void change_baud(uint32_t baud)
+{
+    /*
+       Response: ^!,r,B\n at the current rate, then switch to B
+
+       B = New baud rate, 0 if it isn't supported
+
+       The host must send ^?,@ at the new rate within
+       SER_PROBE_TIME, or the device goes back to SER_BAUD
+    */
+
+    uint8_t idx = 0;
+
+    while (idx < NUM_BAUDS && bauds[idx] != baud) idx++;
+
+    line_begin("r", SER_BUFS_SIZE);
+    line_u(idx < NUM_BAUDS ? baud : 0);
+    line_end();
+
+    if (idx == NUM_BAUDS) return;
+
+    set_baud(idx);
+
+    if (idx == 0) {
+        // Back to the boot rate, nothing to confirm
+        baud_probing = false;
+        sched_cancel(&baud_timer);
+    }
+    else {
+        baud_probing = true;
+        sched_add(&baud_timer, baud_check, SER_PROBE_TIME, 0);
+    }
+}
+
+void commit_batch()
+{
+    /*
+       Response: ^!,x,N\n
+
+       N = Number of changes applied, 0 if no batch was open
+    */
+
+    uint8_t changes = batch_commit();
+
+    line_begin("x", SER_BUFS_SIZE);
+    line_u(changes);
+    line_end();
+
+    if (changes != 0) track_effect();
 }
 
 void send_password()
@@ -149,21 +919,18 @@ void send_password()
     // Response: ^!,c,X,X,X\n
 
     int8_t tmp_p[3];
-    char tmp_s[4];
 
     eeprom_get_password(tmp_p);
 
-    strcpy(tx_buf, "^!,c,");
+    line_begin("c", SER_BUFS_SIZE);
 
     // If password is not set, send 'n' to avoid sign issues
-    strcat(tx_buf, tmp_p[0] == -1 ? "n" : itos(tmp_p[0], get_num_length(tmp_p[0]), tmp_s));
-
-    strcat(tx_buf, ",");
-    strcat(tx_buf, itos(tmp_p[1], get_num_length(tmp_p[1]), tmp_s));
-    strcat(tx_buf, ",");
-    strcat(tx_buf, itos(tmp_p[2], get_num_length(tmp_p[2]), tmp_s));
+    if (tmp_p[0] == -1) line_s("n");
+    else line_u(tmp_p[0]);
 
-    serial_writeln_s(tx_buf);
+    line_u(tmp_p[1]);
+    line_u(tmp_p[2]);
+    line_end();
 }
 
 void send_info()
@@ -178,31 +945,202 @@ void send_info()
        M = Maximum number of slots
     */
 
-    char tmp_s[5];
-    int16_t tmp_n;
-
-    tmp_n = eeprom_get_serial();
+    int8_t def_slot = eeprom_get_default_slot();
 
-    strcpy(tx_buf, "^!,i,");
-    strcat(tx_buf, itos(tmp_n, get_num_length(tmp_n), tmp_s));
-    strcat(tx_buf, ",");
-    strcat(tx_buf, HW_VERSION);
-    strcat(tx_buf, ",");
-    strcat(tx_buf, SW_VERSION);
-    strcat(tx_buf, ",");
-    
-    tmp_n = eeprom_get_default_slot();
+    line_begin("i", SER_BUFS_SIZE);
+    line_u(eeprom_get_serial());
+    line_s(HW_VERSION);
+    line_s(SW_VERSION);
 
     // If no default slot is set, send 'n' to avoid sign issues
-    strcat(tx_buf, tmp_n == -1 ? "n" : itos(tmp_n, get_num_length(tmp_n), tmp_s));
+    if (def_slot == -1) line_s("n");
+    else line_u(def_slot);
+
+    line_u(NUM_SLOTS);
+    line_end();
+}
+
+task_state_t send_playlists(task_t *t)
+{
+    /*
+       Response: ^!,l,X\n
+                 loop X times:
+                     ^!,l,LI,LN,N\n
+                     loop N times:
+                         ^!,t,TI,SI,DW,FD\n
+
+       X = Number of playlists
+       LI = Playlist index
+       LN = Playlist name
+       N = Number of steps (0 if unused)
+       TI = Step index
+       SI = Slot index
+       DW = Dwell time (tenths of a second)
+       FD = Fade time (tenths of a second)
+
+       Each line waits until it fits in the TX buffer
+    */
+
+    static uint8_t i, j;
+    static playlist_t to_send;
+
+    TASK_BEGIN(t);
+
+    TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+    line_begin("l", SER_BUFS_SIZE);
+    line_u(NUM_PLAYLISTS);
+    line_end();
+
+    for (i = 0; i < NUM_PLAYLISTS; i++)
+    {
+        eeprom_get_playlist(i, &to_send);
+
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+        line_begin("l", SER_BUFS_SIZE);
+        line_u(i);
+        line_s(to_send.name);
+        line_u(to_send.num_steps);
+        line_end();
+
+        for (j = 0; j < to_send.num_steps; j++)
+        {
+            TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+            line_begin("t", SER_BUFS_SIZE);
+            line_u(j);
+            line_u(to_send.steps[j].slot);
+            line_u(to_send.steps[j].dwell);
+            line_u(to_send.steps[j].fade);
+            line_end();
+        }
+    }
+
+    TASK_END(t);
+}
+
+void send_events()
+{
+    /*
+       Response: ^!,e,D,M,Q,L,R,P,H,S,T,W\n
+
+       D = Events currently queued
+       M = Highest number of events queued at once
+       Q = Queue size
+       L, R, P, H, S = Dropped left rotation, right rotation, push,
+                       hold and serial events
+       T = Highest event latency, in microseconds
+       W = Longest main loop pass (worst-case UI stall), in microseconds
+    */
+
+    line_begin("e", SER_BUFS_SIZE);
+    line_u(event_get_depth());
+    line_u(event_get_max_depth());
+    line_u(EV_QUEUE_SIZE);
+
+    for (int i = EV_ROT_L; i <= EV_SERIAL; i++) {
+        line_u(event_get_dropped(i));
+    }
+
+    line_u(event_get_max_latency());
+    line_u(event_get_max_stall());
+    line_end();
+}
+
+void send_active()
+{
+    /*
+       Response: ^!,a,S,P,T,Q,W,M\n
+
+       S = Slot on the outputs, -1 if none
+       P = Playlist running, -1 if none
+       T = Step of the running playlist
+       Q = Slow sequence running, -1 if none
+       W = Half seconds since the slow sequence started
+       M = 1 if a morph is running, 0 otherwise
 
-    strcat(tx_buf, ",");
-    strcat(tx_buf, itos(NUM_SLOTS, get_num_length(NUM_SLOTS), tmp_s));
+       Also the reply to ^!,a and ^!,w, once applied
+    */
+
+    line_begin("a", SER_BUFS_SIZE);
+    line_i(get_active_slot());
+    line_i(playlist_running());
+    line_u(playlist_step());
+    line_i(slow_running);
+    line_u(get_slow_time());
+    line_u(morph_running() ? 1 : 0);
+    line_end();
+}
+
+void send_link()
+{
+    /*
+       Response: ^!,q,F,O,P,D,T,E1,E2,E3,E4,E5,C\n
+
+       F, O, P = Bytes received with a framing, overrun and parity
+                 error
+       D = Lines and frames dropped because every buffer was busy
+       T = Lines longer than a buffer
+       E1...E5 = Lines replied with ^!,ERR1 to ^!,ERR5
+       C = Binary frames with a wrong CRC
+
+       Counted since boot or the last ^!,q
+    */
+
+    line_begin("q", LINK_LINE_SIZE);
+
+    for (uint8_t i = 0; i < LINK_COUNT; i++) {
+        line_u(serial_get_count(i));
+    }
+
+    line_end();
+}
+
+task_state_t send_histograms(task_t *t)
+{
+    /*
+       Response: ^!,h,H,B,T\n
+                 loop H times:
+                     ^!,h,HI,C0,...,CB-1\n
+
+       H = Number of histograms (left rotation, right rotation, push,
+           hold, serial, serial command effect on the outputs and
+           formatting of a ^!,p line)
+       B = Number of bins
+       T = Tick length, in microseconds
+       HI = Histogram index
+       CX = Bin count. Bin 0 counts 0 ticks, bin i from 2^(i - 1)
+            to 2^i - 1 ticks
+
+       Each line waits until it fits in the TX buffer
+    */
+
+    static uint8_t i;
+
+    TASK_BEGIN(t);
+
+    TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+    line_begin("h", SER_BUFS_SIZE);
+    line_u(LAT_NUM_HISTS);
+    line_u(LAT_HIST_BINS);
+    line_u(LAT_TICK_US);
+    line_end();
+
+    for (i = 0; i < LAT_NUM_HISTS; i++)
+    {
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= HIST_LINE_SIZE);
+        line_begin("h", HIST_LINE_SIZE);
+        line_u(i);
+
+        for (uint8_t j = 0; j < LAT_HIST_BINS; j++) {
+            line_u(event_get_histogram(i, j));
+        }
+
+        line_end();
+    }
 
-    serial_writeln_s(tx_buf);
+    TASK_END(t);
 }
 
-void send_slots()
+task_state_t send_slots(task_t *t)
 {
     /*
        Response: ^!,n,X\n
@@ -220,152 +1158,427 @@ void send_slots()
        F = Frequency
        D = Duty cycle
        P = Phase
+
+       Each line waits until it fits in the TX buffer. The time
+       spent formatting every ^!,p line goes to LAT_HIST_FORMAT
     */
 
-    char tmp_s[EE_PWM_NAME_SIZE];
-    int16_t tmp_n;
+    static uint8_t num_slots, i, j;
+    static slot_t to_send;
 
-    tmp_n = eeprom_get_used_slots();
+    TASK_BEGIN(t);
 
-    strcpy(tx_buf, "^!,n,");
-    strcat(tx_buf, itos(tmp_n, get_num_length(tmp_n), tmp_s));
-    serial_writeln_s(tx_buf);
+    num_slots = eeprom_get_used_slots();
 
-    slot_t to_send;
+    TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+    line_begin("n", SER_BUFS_SIZE);
+    line_u(num_slots);
+    line_end();
 
-    for (int i = 0; i < tmp_n; i++)
+    for (i = 0; i < num_slots; i++)
     {
         eeprom_get_slot(i, &to_send);
 
-        strcpy(tx_buf, "^!,s,");
-        strcat(tx_buf, itos(i, get_num_length(i), tmp_s));
-        strcat(tx_buf, ",");
-        strcat(tx_buf, to_send.name);
-        serial_writeln_s(tx_buf);
+        TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+        line_begin("s", SER_BUFS_SIZE);
+        line_u(i);
+        line_s(to_send.name);
+        line_end();
 
-        for (int j = 0; j < NUM_PINS; j++)
+        for (j = 0; j < NUM_PINS; j++)
         {
-            strcpy(tx_buf, "^!,p,");
-            strcat(tx_buf, itos(j, get_num_length(j), tmp_s));
-            strcat(tx_buf, ",");
-            strcat(tx_buf, to_send.pwms[j].name);
-            strcat(tx_buf, ",");
-            strcat(tx_buf, itos(to_send.pwms[j].mode,
-                   get_num_length(to_send.pwms[j].mode), tmp_s));
-            strcat(tx_buf, ",");
-            strcat(tx_buf, itos(to_send.pwms[j].frq,
-                   get_num_length(to_send.pwms[j].frq), tmp_s));
-            strcat(tx_buf, ",");
-            strcat(tx_buf, itos(to_send.pwms[j].dty,
-                   get_num_length(to_send.pwms[j].dty), tmp_s));
-            strcat(tx_buf, ",");
-            strcat(tx_buf, itos(to_send.pwms[j].phs,
-                   get_num_length(to_send.pwms[j].phs), tmp_s));
-            serial_writeln_s(tx_buf);
+            TASK_WAIT_UNTIL(t, serial_tx_free() >= SER_BUFS_SIZE);
+
+            // There's room for the whole line, so only formatting is timed
+            uint16_t start = event_now();
+
+            line_begin("p", SER_BUFS_SIZE);
+            line_u(j);
+            line_s(to_send.pwms[j].name);
+            line_u(to_send.pwms[j].mode);
+            line_u(to_send.pwms[j].frq);
+            line_u(to_send.pwms[j].dty);
+            line_i(to_send.pwms[j].phs);
+            line_end();
+
+            event_record_latency(LAT_HIST_FORMAT, event_now() - start);
         }
     }
+
+    TASK_END(t);
 }
 
-uint8_t rx_num_slots;
-uint8_t rx_slot_idx;
-slot_t rx_slots[NUM_SLOTS];
-uint8_t rx_pwm_idx;
 pwm_t rx_pwm;
+uint8_t rx_playlist_idx;
+playlist_t rx_playlist;
 
 void process_data()
 {
-    char *idx;
+    // A line is handed over for every EV_SERIAL
+    if (rx_r_ptr == rx_w_ptr) return;
+
+    uint8_t line = rx_r_ptr & RX_MASK;
+
+    if (rx_lens[line] != 0) frame_process((uint8_t *)rx_lines[line], rx_lens[line]);
+    else parse_line(line);
+
+    rx_r_ptr++;  // Buffer can be filled again
+}
+
+char *rx_text(uint8_t line, uint8_t field) {
+    return &rx_lines[line][rx_starts[line][field]];
+}
 
-    idx = strtok(rx_buf, ",");
+int32_t rx_number(uint8_t line, uint8_t field) {
+    return rx_values[line][field];
+}
+
+bool rx_in_range(uint8_t line, uint8_t field, int32_t min, int32_t max) {
+    return rx_values[line][field] >= min && rx_values[line][field] <= max;
+}
+
+bool check_args(uint8_t line, const char *format) {
+    uint8_t field = 2;  // After the '!' and the command
+
+    for (uint8_t i = 0; format[i] != '\0'; i++, field++) {
+        if (field >= rx_num_fields[line]) return format[i] == 'o';
+
+        // Text at the end takes the rest of the line, commas included
+        if (format[i] == 's' && format[i + 1] == '\0') {
+            for (uint8_t j = field + 1; j < rx_num_fields[line]; j++) {
+                rx_lines[line][rx_starts[line][j] - 1] = ',';
+            }
+
+            return true;
+        }
+
+        if (format[i] != 's' && !(rx_numeric[line] & _BV(field))) return false;
+    }
 
-    if (idx[0] == '?')  // App is asking for something
+    return field == rx_num_fields[line];
+}
+
+bool check_tag(const char *tag) {
+    uint8_t len = 0;
+
+    for (; tag[len] != '\0'; len++) {
+        if (!isalnum(tag[len])) return false;
+    }
+
+    return len != 0 && len <= SER_TAG_SIZE;
+}
+
+void parse_line(uint8_t line)
+{
+    set_reply_tag("");
+    line_sent = false;
+
+    if (rx_tagged[line]) {
+        // Nothing after the tag, or a tag that can't be echoed
+        if (rx_starts[line][0] == 0) { send_error(1); return; }
+        if (!check_tag(rx_lines[line] + 1)) { send_error(4); return; }
+
+        set_reply_tag(rx_lines[line] + 1);
+    }
+
+    // Replies would get mixed up with the ones being sent, tagged
+    // ones can be told apart. Commands could change what's being
+    // sent halfway through, so only tagged queries get through
+    if (running_task != NULL &&
+        (!rx_tagged[line] || strcmp(rx_text(line, 0), "?") != 0)) {
+        send_reply("BUSY");
+        set_reply_tag("");
+        return;
+    }
+
+    run_line(line);
+
+    // Tagged commands with no reply of their own are confirmed
+    if (reply_tag[0] != '\0' && !line_sent) send_reply("OK");
+
+    set_reply_tag("");
+}
+
+void run_line(uint8_t line)
+{
+    char *cmd;
+
+    if (rx_too_long[line]) {
+        serial_count(LINK_TRUNCATED);
+        send_error(4);
+        return;
+    }
+
+    if (rx_num_fields[line] < 2) { send_error(1); return; }
+
+    cmd = rx_text(line, 1);
+
+    if (strlen(cmd) != 1) { send_error(3); return; }
+
+    if (strcmp(rx_text(line, 0), "?") == 0)  // App is asking for something
     {
-        idx = strtok(NULL, "\n");
+        if (rx_num_fields[line] != 2) { send_error(4); return; }
 
-        if (strlen(idx) > 1) { serial_write_s("^!,ERR3\n"); return; }
-        
-        switch (idx[0])
+        switch (cmd[0])
         {
             case '@': send_handshake(); break;  // Initial handshake
             case 'c': send_password(); break;  // Password
             case 'i': send_info(); break;  // Device info
-            case 's': send_slots(); break;  // Slots
-            default: serial_write_s("^!,ERR2\n"); return;
+            case 's': if (!serial_start_task(send_slots)) send_reply("BUSY"); break;  // Slots
+            case 'l': if (!serial_start_task(send_playlists)) send_reply("BUSY"); break;  // Playlists
+            case 'e': send_events(); break;  // Event queue statistics
+            case 'h': if (!serial_start_task(send_histograms)) send_reply("BUSY"); break;  // Latency histograms
+            case 'b':  // Switch to the binary protocol, once every reply is out
+                if (running_task != NULL) send_reply("BUSY");
+                else send_binary();
+                break;
+            case 'k': send_hashes(); break;  // Slot hashes
+            case 'r': send_bauds(); break;  // Supported baud rates
+            case 'q': send_link(); break;  // Link quality counters
+            case 'a': send_active(); break;  // Live state
+            default: send_error(2); return;
         }
     }
-    else if (idx[0] == '!')  // App wants to change one of the settings
+    else if (strcmp(rx_text(line, 0), "!") == 0)  // App wants to change one of the settings
     {
-        int8_t tmp_p[3];
-        uint8_t tmp_n;
+        const char *format;
+        int32_t tmp_l;
+        bool valid = true;
+
+        // Arguments: 'n' number, 'o' optional number, 's' text
+        switch (cmd[0])
+        {
+            case 'c': format = "nnn"; break;
+            case 'd': case 'n': case 'r': case 'u': case 'a': case 'w': format = "n"; break;
+            case 's': format = "ns"; break;
+            case 'p': format = "nsnnnn"; break;
+            case 'l': format = "nsn"; break;
+            case 't': format = "nnno"; break;
+            case 'm': format = "nn"; break;
+            case 'h': case 'q': format = ""; break;
+            case 'x': format = "s"; break;
+            case 'v': format = "nnnnn"; break;
+            case 'g': format = "n"; break;
+            default: send_error(2); return;
+        }
 
-        idx = strtok(NULL, ",");
+        if (!check_args(line, format)) { send_error(4); return; }
 
-        if (strlen(idx) > 1) { serial_write_s("^!,ERR3\n"); return; }
+        // Only what a batch can hold is accepted while it's open, and
+        // channel changes are only accepted then
+        if (batch_active() ? strchr("dgvx", cmd[0]) == NULL : cmd[0] == 'v') {
+            send_error(5);
+            return;
+        }
 
-        switch (idx[0])
+        switch (cmd[0])
         {
-            case 'c':  // Password
-                idx = strtok(NULL, ",");
-                tmp_p[0] = atoi(idx);
-                idx = strtok(NULL, ",");
-                tmp_p[1] = atoi(idx);
-                idx = strtok(NULL, ",");
-                tmp_p[2] = atoi(idx);
+            case 'c': {  // Password, -1 first means not set
+                int8_t tmp_p[3];
+
+                valid = rx_in_range(line, 2, -1, 9) &&
+                        rx_in_range(line, 3, 0, 9) &&
+                        rx_in_range(line, 4, 0, 9);
+                if (!valid) break;
+
+                tmp_p[0] = rx_number(line, 2);
+                tmp_p[1] = rx_number(line, 3);
+                tmp_p[2] = rx_number(line, 4);
 
                 eeprom_set_password(tmp_p);
 
                 break;
+            }
+
+            case 'd':  // Default slot, -1 for none
+                valid = rx_in_range(line, 2, -1, NUM_SLOTS - 1);
+                if (!valid) break;
 
-            case 'd':  // Default slot
-                idx = strtok(NULL, "\n");
-                tmp_n = atoi(idx);
-                
-                eeprom_set_default_slot(tmp_n);
+                if (batch_active()) batch_set_default_slot(rx_number(line, 2));
+                else eeprom_set_default_slot(rx_number(line, 2));
 
                 break;
 
             case 'n':  // Number of slots about to be sent
-                idx = strtok(NULL, "\n");
-                rx_num_slots = atoi(idx);
+                valid = rx_in_range(line, 2, 0, NUM_SLOTS);
+                if (valid) upload_start(rx_number(line, 2));
+
+                break;
+
+            case 'r':  // Baud rate, once every reply is out
+                valid = rx_in_range(line, 2, 0, RX_MAX_VALUE);
+                if (!valid) break;
+
+                if (running_task != NULL) send_reply("BUSY");
+                else change_baud(rx_number(line, 2));
+
+                break;
 
-                eeprom_delete_all_slots();
-                unload_active_slot();
+            case 'u':  // Number of slots, only the changed ones will be sent
+                valid = rx_in_range(line, 2, 0, NUM_SLOTS);
+                if (valid) upload_sync(rx_number(line, 2));
 
                 break;
 
             case 's':  // Slot index and name
-                idx = strtok(NULL, ",");
-                rx_slot_idx = atoi(idx);
-                idx = strtok(NULL, "\n");
-                strcpy(rx_slots[rx_slot_idx].name, idx);
+                valid = rx_in_range(line, 2, 0, NUM_SLOTS - 1);
+                if (valid) upload_slot(rx_number(line, 2), rx_text(line, 3));
 
                 break;
 
-            case 'p':  // PWM
-                idx = strtok(NULL, ",");
-                rx_pwm_idx = atoi(idx);
-                idx = strtok(NULL, ",");
-                strcpy(rx_slots[rx_slot_idx].pwms[rx_pwm_idx].name, idx);
-                idx = strtok(NULL, ",");
-                rx_slots[rx_slot_idx].pwms[rx_pwm_idx].mode = atoi(idx);
-                idx = strtok(NULL, ",");
-                rx_slots[rx_slot_idx].pwms[rx_pwm_idx].frq = atoi(idx);
-                idx = strtok(NULL, ",");
-                rx_slots[rx_slot_idx].pwms[rx_pwm_idx].dty = atoi(idx);
-                idx = strtok(NULL, "\n");
-                rx_slots[rx_slot_idx].pwms[rx_pwm_idx].phs = atoi(idx);
-
-                // Last PWM, save slot in EEPROM
-                if (rx_slot_idx == (rx_num_slots - 1) && (rx_pwm_idx == (NUM_PINS - 1))) {
-                    for (int i = 0; i < rx_num_slots; i++) {
-                        eeprom_new_slot(&rx_slots[i]);
-                    }
+            case 'p': {  // PWM
+                pwm_t pwm;
+
+                // Frequency 0 is only valid for OFF and ON channels, see
+                // pin_values_valid()
+                valid = rx_in_range(line, 2, 0, NUM_PINS - 1) &&
+                        rx_in_range(line, 4, OFF_MODE, ON_MODE) &&
+                        rx_in_range(line, 5, 0, PWM_MAX_FRQ) &&
+                        rx_in_range(line, 6, 0, 100) &&
+                        rx_in_range(line, 7, -99, 99) &&
+                        pin_values_valid(rx_number(line, 4), rx_number(line, 5),
+                                         rx_number(line, 6), rx_number(line, 7));
+                if (!valid) break;
+
+                rx_pwm_idx = rx_number(line, 2);
+                strncpy(pwm.name, rx_text(line, 3), EE_PWM_NAME_SIZE);
+                pwm.mode = rx_number(line, 4);
+                pwm.frq = rx_number(line, 5);
+                pwm.dty = rx_number(line, 6);
+                pwm.phs = rx_number(line, 7);
+
+                upload_pwm(rx_slot_idx, rx_pwm_idx, &pwm);
+
+                break;
+            }
+
+            case 'l':  // Playlist index, name and number of steps
+                valid = rx_in_range(line, 2, 0, NUM_PLAYLISTS - 1) &&
+                        rx_in_range(line, 4, 0, PL_MAX_STEPS);
+                if (!valid) break;
+
+                rx_playlist_idx = rx_number(line, 2);
+                strncpy(rx_playlist.name, rx_text(line, 3), EE_PLAYLIST_NAME_SIZE - 1);
+                rx_playlist.name[EE_PLAYLIST_NAME_SIZE - 1] = '\0';
+                rx_playlist.num_steps = rx_number(line, 4);
+
+                // An empty playlist is deleted right away
+                if (rx_playlist.num_steps == 0) {
+                    if (playlist_running() == rx_playlist_idx) playlist_stop();
+                    eeprom_set_playlist(rx_playlist_idx, &rx_playlist);
                 }
 
                 break;
 
-            default: serial_write_s("^!,ERR2\n"); return;
+            case 't': {  // Playlist step
+                uint8_t step;
+
+                valid = rx_in_range(line, 2, 0, PL_MAX_STEPS - 1) &&
+                        rx_in_range(line, 3, 0, NUM_SLOTS - 1);
+                if (!valid) break;
+
+                step = rx_number(line, 2);
+                rx_playlist.steps[step].slot = rx_number(line, 3);
+
+                // Out of range times are limited rather than rejected
+                tmp_l = rx_number(line, 4);
+                rx_playlist.steps[step].dwell = tmp_l < 1 ? 1 : (tmp_l > UINT16_MAX ? UINT16_MAX : tmp_l);
+
+                tmp_l = rx_num_fields[line] > 5 ? rx_number(line, 5) : 0;  // Optional
+                rx_playlist.steps[step].fade = tmp_l < 0 ? 0 : (tmp_l > rx_playlist.steps[step].dwell ? rx_playlist.steps[step].dwell : tmp_l);
+
+                // Last step, save playlist in EEPROM
+                if (step == (rx_playlist.num_steps - 1)) {
+                    if (playlist_running() == rx_playlist_idx) playlist_stop();
+                    eeprom_set_playlist(rx_playlist_idx, &rx_playlist);
+                }
+
+                break;
+            }
+
+            case 'm':  // Morph into a slot
+                valid = rx_in_range(line, 2, 0, NUM_SLOTS - 1);
+                if (!valid) break;
+
+                tmp_l = rx_number(line, 3);
+
+                playlist_stop();
+                if (morph_start(rx_number(line, 2), tmp_l < 0 ? 0 : (tmp_l > UINT16_MAX ? UINT16_MAX : tmp_l))) {
+                    track_morph();
+                }
+
+                break;
+
+            case 'h':  // Clear latency histograms
+                event_clear_histograms();
+
+                break;
+
+            case 'a':  // Put a slot on the outputs, -1 to unload it
+                valid = rx_in_range(line, 2, -1, eeprom_get_used_slots() - 1);
+                if (!valid) break;
+
+                activate_slot(rx_number(line, 2));
+                track_effect();
+                send_active();
+
+                break;
+
+            case 'w':  // Start a slow sequence, -1 to stop it
+                valid = rx_in_range(line, 2, -1, SLOW_NUM_ENTRIES - 1);
+                if (!valid) break;
+
+                slow_start(rx_number(line, 2));
+                send_active();
+
+                break;
+
+            case 'q':  // Clear link quality counters
+                serial_clear_counts();
+
+                break;
+
+            case 'x':  // Batch: begin, commit or abort
+                cmd = rx_text(line, 2);
+                valid = strlen(cmd) == 1;
+
+                if (!valid) break;
+                else if (cmd[0] == 'b') batch_begin();
+                else if (cmd[0] == 'c') commit_batch();
+                else if (cmd[0] == 'a') batch_abort();
+                else valid = false;
+
+                break;
+
+            case 'v':  // Channel change, applied on commit
+                valid = rx_in_range(line, 2, 0, NUM_PINS - 1) &&
+                        rx_in_range(line, 3, OFF_MODE, ON_MODE) &&
+                        rx_in_range(line, 4, 1, PWM_MAX_FRQ) &&
+                        rx_in_range(line, 5, 0, 100) &&
+                        rx_in_range(line, 6, -99, 99);
+                if (!valid) break;
+
+                batch_set_pin(rx_number(line, 2), rx_number(line, 3), rx_number(line, 4),
+                              rx_number(line, 5), rx_number(line, 6));
+
+                break;
+
+            case 'g':  // Screen brightness
+                valid = rx_in_range(line, 2, LCD_MIN_BRIGHTNESS, LCD_MAX_BRIGHTNESS);
+                if (!valid) break;
+
+                if (batch_active()) {
+                    batch_set_brightness(rx_number(line, 2));
+                }
+                else {
+                    set_brightness(rx_number(line, 2));
+                    eeprom_set_brightness(rx_number(line, 2));
+                }
+
+                break;
         }
+
+        if (!valid) send_error(4);
     }
-    else { serial_write_s("^!,ERR1\n"); return; }  // Not handled
-}
\ No newline at end of file
+    else { send_error(1); return; }  // Not handled
+}
@@ -0,0 +1,92 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ *
+ * @brief Periodic status frames for the binary protocol
+ */
+
+#include "sys/io/telemetry_control.h"
+
+#include "sys/io/frame_control.h"
+#include "sys/io/serial_control.h"
+#include "sys/scheduler.h"
+#include "sys/event_control.h"
+#include "sys/menu_control.h"
+#include "sys/morph_control.h"
+#include "sys/playlist_control.h"
+#include "sys/menu/list_menu.h"
+#include "sys/menu/slow_menu.h"
+#include "pwm/pwm_gen.h"
+
+#if FRAME_MAX_DATA < 52
+    #error "Status frames don't fit in a frame"
+#endif
+
+static sched_timer_t telemetry_timer;
+static uint8_t telemetry_seq;
+static uint16_t skipped = 0;
+
+
+/* Local declarations */
+
+void send_status();
+
+
+/* Definitions */
+
+void telemetry_start(uint8_t seq, uint16_t period) {
+    if (period < TELEMETRY_MIN_PERIOD) period = TELEMETRY_MIN_PERIOD;
+
+    telemetry_seq = seq;
+    pwm_load();  // Load is measured from now on
+
+    sched_add(&telemetry_timer, send_status, period, period);
+}
+
+void telemetry_stop() {
+    sched_cancel(&telemetry_timer);
+}
+
+void send_status() {
+    status_t status;
+
+    // Link went back to ASCII
+    if (!serial_binary()) { telemetry_stop(); return; }
+
+    if (serial_tx_free() < FRAME_MAX_SIZE) { skipped++; return; }
+
+    telemetry_get_status(&status);
+    status.isr_load = pwm_load();  // Each frame covers one period
+    frame_send(FR_STATUS, telemetry_seq, &status, sizeof(status_t));
+}
+
+void telemetry_get_status(status_t *status) {
+    status->tick = pwm_ticks();
+    status->active_slot = get_active_slot();
+    status->playlist = playlist_running();
+    status->playlist_step = playlist_step();
+    status->slow = slow_running;
+    status->slow_time = get_slow_time();
+    status->flags = morph_running() ? 1 : 0;
+    status->pin_states = 0;
+    status->modes = 0;
+
+    for (uint8_t i = 0; i < NUM_PINS; i++) {
+        if (*active_pins[i].port & _BV(active_pins[i].pin)) status->pin_states |= _BV(i);
+
+        status->modes |= (uint16_t)active_pins[i].mode << (2 * i);
+        status->pins[i].frq = active_pins[i].frq;
+        status->pins[i].dty = active_pins[i].dty;
+        status->pins[i].phs = active_pins[i].phs;
+    }
+
+    status->isr_load = pwm_load_peek();
+    status->queue_depth = event_get_depth();
+    status->dropped = 0;
+
+    for (uint8_t ev = EV_NONE + 1; ev < EV_COUNT; ev++) {
+        status->dropped += event_get_dropped(ev);
+    }
+
+    status->skipped = skipped;
+}
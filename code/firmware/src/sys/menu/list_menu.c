@@ -12,13 +12,17 @@
 #include "sys/menu_control.h"
 #include "sys/lcd_screen.h"
 #include "sys/eeprom_control.h"
+#include "sys/playlist_control.h"
+#include "sys/morph_control.h"
+#include "sys/menu/slow_menu.h"
 
 static char entries[LST_NUM_ENTRIES][LCD_WIDTH] = {
     "", "", "", "", "", "", "", "", // PWM names will be set at runtime
     "LOAD",
     "SAVE",
     "DELETE",
-    "BRIGHTNESS"
+    "BRIGHTNESS",
+    "PLAY"
 };
 
 static int8_t active_slot;
@@ -28,8 +32,10 @@ static bool on_load = false;
 static uint8_t on_save = 0;
 static uint8_t on_delete = 0;
 static bool on_brightness = false;
+static bool on_play = false;
 static bool selected_confirm = false;
 static uint8_t selected_slot = 0;
+static uint8_t selected_playlist = 0;
 
 void list_menu_setup() {
     active_slot = eeprom_get_default_slot();
@@ -111,25 +117,56 @@ void list_reload() {
 
         lcd_puts(itos(5 - get_brightness() / 20, 1, tmp));
 
+        lcd_putc(RIGHT_ARROW);
+    }
+    else if (on_play) {
+        lcd_gotoxy(5, local_cursor);
+        lcd_putc(LEFT_ARROW);
+
+        if (selected_playlist == 0) {
+            if (playlist_running() != -1) lcd_puts("STOP");
+            else lcd_puts("BACK");
+        }
+        else {
+            playlist_t playlist;
+            eeprom_get_playlist(selected_playlist - 1, &playlist);
+            lcd_puts(playlist.name);
+        }
+
         lcd_putc(RIGHT_ARROW);
     }
 }
 
 void list_scroll(int8_t dir) {
     if (on_load || on_delete == 1) {
-        selected_slot = wrap(selected_slot + dir, 0, eeprom_get_used_slots());
+        selected_slot = wrap_around(selected_slot + dir, 0, eeprom_get_used_slots());
         reload_screen();
 
         return;
     }
     else if (on_save == 1) {
-        selected_slot = wrap(selected_slot + dir, 0, eeprom_get_used_slots() + 1); // Available slots + NEW
+        selected_slot = wrap_around(selected_slot + dir, 0, eeprom_get_used_slots() + 1); // Available slots + NEW
         reload_screen();
 
         return;
     }
     else if (on_save == 2 || on_delete == 2) {
-        selected_confirm = !selected_confirm;
+        if (dir & 1) selected_confirm = !selected_confirm;
+        reload_screen();
+
+        return;
+    }
+    else if (on_play) {
+        int8_t step = (dir > 0) ? 1 : -1;
+
+        // Skip unused playlists, one entry per step
+        for (int8_t i = 0; i != dir; i += step) {
+            do {
+                selected_playlist = wrap(selected_playlist + step, 0, NUM_PLAYLISTS);
+            } while (selected_playlist != 0 &&
+                     eeprom_get_playlist_steps(selected_playlist - 1) == 0);
+        }
+
         reload_screen();
 
         return;
@@ -141,19 +178,7 @@ void list_scroll(int8_t dir) {
         return;
     }
 
-    bool min, max;
-    local_cursor = limit_hit(local_cursor + dir, 0, 3, &min, &max);
-
-    if (min || max) {
-        global_cursor = wrap_hit(global_cursor + dir, 0, LST_NUM_ENTRIES - LCD_LINES, &min, &max);
-
-        if (max) { // It hit the max value, so it wrapped
-            local_cursor = 0;
-        }
-        else if (min) { // It hit the min value, so it wrapped
-            local_cursor = 3;
-        }
-    }
+    scroll_window(&global_cursor, &local_cursor, dir, LST_NUM_ENTRIES, LCD_LINES);
 
     reload_screen();
 }
@@ -174,22 +199,7 @@ void list_button_press() {
                 on_load = true;
             }
             else {
-                if (selected_slot != 0) {
-                    active_slot = selected_slot - 1;
-
-                    slot_t to_load;
-                    eeprom_get_slot(active_slot, &to_load);
-
-                    for (int i = 0; i < 8; i++){
-                        set_pin_mode(active_pins, i, to_load.pwms[i].mode);
-                        set_pin_config(active_pins, i,
-                                          to_load.pwms[i].frq,
-                                          to_load.pwms[i].dty);
-                        set_pin_phase(active_pins, i, to_load.pwms[i].phs);
-                    }
-
-                    sync_pwms(active_pins);
-                }
+                if (selected_slot != 0) activate_slot(selected_slot - 1);
 
                 on_load = false;
             }
@@ -294,6 +304,27 @@ void list_button_press() {
             reload_screen();
             break;
 
+        // PLAY option
+        case LST_PLAY_INDEX:
+            if (get_locked()) {
+                change_menu(PASS_MENU);
+                return;
+            }
+
+            if (on_play == 0) {
+                selected_playlist = 0;
+                on_play = true;
+            }
+            else {
+                if (selected_playlist == 0) playlist_stop();
+                else playlist_start(selected_playlist - 1);
+
+                on_play = false;
+            }
+
+            reload_screen();
+            break;
+
         default:
             select_pin(selected);
             change_menu(PWM_MENU);
@@ -322,8 +353,48 @@ void list_update_names() {
     }
 }
 
+void load_slot(uint8_t ui_idx) {
+    pwm_pin_t staged[NUM_PINS];
+    slot_t to_load;
+
+    morph_stop();
+
+    active_slot = ui_idx;
+    eeprom_get_slot(active_slot, &to_load);
+    copy_pins(active_pins, staged);
+
+    for (int i = 0; i < NUM_PINS; i++) {
+        set_pin_mode(staged, i, to_load.pwms[i].mode);
+        set_pin_config(staged, i, to_load.pwms[i].frq, to_load.pwms[i].dty);
+        staged[i].phs = to_load.pwms[i].phs;
+    }
+
+    commit_pins(active_pins, staged);
+    list_update_names();
+}
+
+void activate_slot(int8_t ui_idx) {
+    // They would overwrite the slot on their next step
+    slow_stop();
+    playlist_stop();
+
+    if (ui_idx == -1) {
+        unload_active_slot();
+        return;
+    }
+
+    load_slot(ui_idx);
+    reload_screen();
+}
+
+int8_t get_active_slot() {
+    return active_slot;
+}
+
 void unload_active_slot() {
     active_slot = -1;
+    playlist_stop();
+    morph_stop();
 
     for (int i = 0; i < 8; i++) {
         set_pin_mode(active_pins, i, 0);
@@ -87,13 +87,13 @@ void pass_reload() {
 
 void pass_scroll(int dir) {
     if (on_item) {
-        input[local_cursor - 1] = wrap(input[local_cursor - 1] + dir, 0, 9);
+        input[local_cursor - 1] = wrap_around(input[local_cursor - 1] + dir, 0, 9);
     }
     else {
-        local_cursor = wrap(local_cursor + dir, 0, 4);
+        local_cursor = wrap_around(local_cursor + dir, 0, 4);
     }
 
-    pass_reload();
+    reload_screen();
 }
 
 void pass_button_press() {
@@ -108,7 +108,7 @@ void pwm_reload() {
 void pwm_scroll(int dir) {
     // General menu navigation
     if (!on_item) {
-        local_cursor = wrap(local_cursor + dir, 0, LCD_LINES);
+        local_cursor = wrap_around(local_cursor + dir, 0, LCD_LINES);
     }
     else {
         pin_mode new_en = active_pins[selected_pin].mode;
@@ -118,7 +118,7 @@ void pwm_scroll(int dir) {
 
         // Changing mode
         if (local_cursor == 0) {
-            new_en = wrap(new_en + dir, 0, 2);
+            new_en = wrap_around(new_en + dir, 0, 2);
             set_pin_mode(active_pins, selected_pin, new_en);
         }
         // Changing frequency
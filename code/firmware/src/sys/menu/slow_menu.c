@@ -11,6 +11,9 @@
 #include "sys/menu_control.h"
 #include "sys/lcd_screen.h"
 #include "sys/io/serial_control.h"
+#include "sys/playlist_control.h"
+#include "sys/morph_control.h"
+#include "sys/scheduler.h"
 
 
 static char entries[SLOW_NUM_ENTRIES][LCD_WIDTH] = {
@@ -24,6 +27,9 @@ static char entries[SLOW_NUM_ENTRIES][LCD_WIDTH] = {
 static uint8_t local_cursor = 0;
 static uint8_t global_cursor = 0;
 
+static sched_timer_t slow_timer;
+static uint16_t slow_time = 0;
+
 
 /* Local decalarations */
 
@@ -31,18 +37,22 @@ bool blinkers_on = false;
 bool fernlitch_on = false;
 bool abblendlicht_on = false;
 
-void update_blinkers(uint64_t half_seconds);
-void update_fernlicht(uint64_t half_seconds);
-void update_fernlicht_lr(uint64_t half_seconds);
-void update_fernlicht_m(uint64_t half_seconds);
-void update_tag_abb(uint64_t half_seconds);
+void slow_begin(uint8_t idx);
+void slow_tick();
+void update_blinkers(uint16_t half_seconds);
+void update_fernlicht(uint16_t half_seconds);
+void update_fernlicht_lr(uint16_t half_seconds);
+void update_fernlicht_m(uint16_t half_seconds);
+void update_tag_abb(uint16_t half_seconds);
 
 
 /* Definitions */
 
 void slow_menu_setup()
 {
-    slow_running = -1;
+    slow_stop();
+    playlist_stop();
+    morph_stop();
 
     for (int i = 0; i < NUM_PINS; i++) {
         set_pin_mode(active_pins, i, OFF_MODE);
@@ -51,6 +61,11 @@ void slow_menu_setup()
     }
 }
 
+uint16_t get_slow_time()
+{
+    return slow_time;
+}
+
 void slow_reload() {
     if (slow_running == -1) {
         lcd_clrscr();
@@ -84,19 +99,7 @@ void slow_reload() {
 
 void slow_scroll(int8_t dir) {
     if (slow_running == -1) {
-        bool min, max;
-        local_cursor = limit_hit(local_cursor + dir, 0, 3, &min, &max);
-
-        if (min || max) {
-            global_cursor = wrap_hit(global_cursor + dir, 0, SLOW_NUM_ENTRIES - LCD_LINES, &min, &max);
-
-            if (max) { // It hit the max value, so it wrapped
-                local_cursor = 0;
-            }
-            else if (min) { // It hit the min value, so it wrapped
-                local_cursor = 3;
-            }
-        }
+        scroll_window(&global_cursor, &local_cursor, dir, SLOW_NUM_ENTRIES, LCD_LINES);
     }
 
     reload_screen();
@@ -104,7 +107,7 @@ void slow_scroll(int8_t dir) {
 
 void slow_button_press() {
     if (slow_running == -1) {
-        slow_running = local_cursor + global_cursor;
+        slow_begin(local_cursor + global_cursor);
     }
     else {
         slow_menu_setup();  // Ensure all signals are off
@@ -113,7 +116,37 @@ void slow_button_press() {
     reload_screen();
 }
 
-void slow_signal(uint64_t half_seconds)
+void slow_start(int8_t idx) {
+    // Entering the menu turns every output off
+    if (get_current_menu() != SLOW_MENU) change_menu(SLOW_MENU);
+    else slow_menu_setup();
+
+    if (idx != -1) slow_begin(idx);
+
+    reload_screen();
+}
+
+void slow_stop() {
+    slow_running = -1;
+    sched_cancel(&slow_timer);
+}
+
+void slow_begin(uint8_t idx) {
+    slow_running = idx;
+
+    // First step right away, then every half second
+    slow_time = 0;
+    sched_add(&slow_timer, slow_tick, 0, SLOW_STEP_TIME);
+}
+
+void slow_tick() {
+    slow_signal(slow_time++);
+
+    // Sequences end by themselves
+    if (slow_running == -1) sched_cancel(&slow_timer);
+}
+
+void slow_signal(uint16_t half_seconds)
 {
     switch (slow_running)
     {
@@ -125,7 +158,7 @@ void slow_signal(uint64_t half_seconds)
     }
 }
 
-void update_blinkers(uint64_t half_seconds) {
+void update_blinkers(uint16_t half_seconds) {
     switch (half_seconds) {
         case 0:
             set_pin_config(active_pins, SLOW_BL_PIN, 10, 50);
@@ -139,7 +172,7 @@ void update_blinkers(uint64_t half_seconds) {
     }
 }
 
-void update_fernlicht(uint64_t half_seconds) {
+void update_fernlicht(uint16_t half_seconds) {
     switch(half_seconds) {
         case 0:
             set_pin_mode(active_pins, SLOW_FL_PIN, ON_MODE);
@@ -162,7 +195,7 @@ void update_fernlicht(uint64_t half_seconds) {
     }
 }
 
-void update_fernlicht_lr(uint64_t half_seconds)
+void update_fernlicht_lr(uint16_t half_seconds)
 {
     switch (half_seconds)
     {
@@ -190,7 +223,7 @@ void update_fernlicht_lr(uint64_t half_seconds)
     }
 }
 
-void update_fernlicht_m(uint64_t half_seconds) {
+void update_fernlicht_m(uint16_t half_seconds) {
     switch (half_seconds)
     {
         case 0:
@@ -217,7 +250,7 @@ void update_fernlicht_m(uint64_t half_seconds) {
     }
 }
 
-void update_tag_abb(uint64_t half_seconds) {
+void update_tag_abb(uint16_t half_seconds) {
     switch (half_seconds)
     {
         case 0:
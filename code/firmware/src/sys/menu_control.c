@@ -15,6 +15,7 @@
 #include "sys/menu/pass_menu.h"
 #include "sys/menu/slow_menu.h"
 #include "sys/eeprom_control.h"
+#include "sys/scheduler.h"
 
 #include "sys/io/serial_control.h"
 
@@ -35,6 +36,20 @@ static const PROGMEM unsigned char cchars[][8] = {
 
 bool locked = true;
 
+static sched_timer_t warn_timer;
+static sched_timer_t frame_timer;
+static bool dirty = false;
+
+
+/* Local declarations */
+
+void warn_timeout();
+void draw_screen();
+void frame_end();
+
+
+/* Definitions */
+
 void menu_setup(pwm_pin_t *pwm_pins){
     // Set up pins for the LCD
     lcd_init(LCD_DISP_ON);
@@ -79,6 +94,10 @@ void change_menu(Menu next_menu) {
         // If changing to the slow menu, reinitialize PWMs
         if (current_menu == SLOW_MENU) slow_menu_setup();
 
+        // Warnings go away by themselves
+        if (current_menu == WARN_MENU) sched_add(&warn_timer, warn_timeout, UI_BOOT_DELAY * 1000UL, 0);
+        else sched_cancel(&warn_timer);
+
         reload_screen();
     }
 }
@@ -87,6 +106,10 @@ void revert_menu() {
     change_menu(previous_menu);
 }
 
+void warn_timeout() {
+    if (current_menu == WARN_MENU) revert_menu();
+}
+
 bool get_locked() {
     return locked;
 }
@@ -104,6 +127,20 @@ uint8_t get_brightness() {
 }
 
 void reload_screen() {
+    dirty = true;
+
+    // Otherwise it's drawn when the current frame ends
+    if (!sched_active(&frame_timer)) draw_screen();
+}
+
+void frame_end() {
+    if (dirty) draw_screen();
+}
+
+void draw_screen() {
+    dirty = false;
+    sched_add(&frame_timer, frame_end, LCD_FRAME_TIME, 0);
+
     switch (current_menu) {
         case INFO_MENU:
             info_menu();
@@ -127,6 +164,9 @@ void reload_screen() {
 }
 
 void scroll(int dir) {
+    // The library is being replaced, there's nothing to edit
+    if (eeprom_restoring()) return;
+
     switch (current_menu){
         case LIST_MENU:
             list_scroll(dir);
@@ -146,6 +186,8 @@ void scroll(int dir) {
 }
 
 void button_press(){
+    if (eeprom_restoring()) return;
+
     switch (current_menu) {
         case LIST_MENU:
             list_button_press();
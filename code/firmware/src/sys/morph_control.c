@@ -0,0 +1,135 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ * 
+ * @brief Timed transitions between the active configuration and
+ * a stored slot
+ */
+
+#include "sys/morph_control.h"
+
+#include "common/config.h"
+#include "pwm/virtual_PWM.h"
+#include "sys/eeprom_control.h"
+#include "sys/menu_control.h"
+#include "sys/menu/list_menu.h"
+#include "sys/scheduler.h"
+
+/**
+ * @brief Start and end values of a channel
+ */
+typedef struct morph_pin_t {
+    bool active; /**< Whether the channel changes at all */
+    int16_t frq[2]; /**< Start and end frequencies */
+    int16_t dty[2]; /**< Start and end duty cycles */
+    int16_t phs[2]; /**< Start and end phases */
+} morph_pin_t;
+
+static morph_pin_t channels[NUM_PINS];
+static bool running = false;
+static sched_timer_t morph_timer;
+static uint8_t target;
+static uint32_t start_time;
+static uint32_t duration_ms;
+
+
+/* Local declarations */
+
+void morph_update();
+int16_t lerp(int16_t *values, uint16_t frac);
+uint16_t effective_dty(uint8_t mode, uint16_t dty);
+
+
+/* Definitions */
+
+bool morph_start(uint8_t ui_idx, uint16_t duration) {
+    if (ui_idx >= eeprom_get_used_slots()) return false;
+
+    slot_t to_load;
+    eeprom_get_slot(ui_idx, &to_load);
+
+    for (int i = 0; i < NUM_PINS; i++) {
+        uint8_t from_mode = active_pins[i].mode;
+        uint8_t to_mode = to_load.pwms[i].mode;
+
+        channels[i].active = from_mode == PWM_MODE || from_mode != to_mode;
+
+        if (!channels[i].active) continue;
+
+        channels[i].frq[0] = active_pins[i].frq;
+        channels[i].frq[1] = to_load.pwms[i].frq;
+        channels[i].dty[0] = effective_dty(from_mode, active_pins[i].dty);
+        channels[i].dty[1] = effective_dty(to_mode, to_load.pwms[i].dty);
+        channels[i].phs[0] = active_pins[i].phs;
+        channels[i].phs[1] = to_load.pwms[i].phs;
+
+        // OFF and ON channels don't have a meaningful frequency
+        if (from_mode != PWM_MODE) channels[i].frq[0] = channels[i].frq[1];
+        if (to_mode != PWM_MODE) channels[i].frq[1] = channels[i].frq[0];
+
+        if (channels[i].frq[0] == 0) channels[i].frq[0] = MORPH_DEFAULT_FRQ;
+        if (channels[i].frq[1] == 0) channels[i].frq[1] = MORPH_DEFAULT_FRQ;
+
+        // Same output as before, but now it can be faded
+        set_pin_config(active_pins, i, channels[i].frq[0], channels[i].dty[0]);
+        set_pin_mode(active_pins, i, PWM_MODE);
+    }
+
+    target = ui_idx;
+    start_time = millis();
+    duration_ms = (uint32_t)duration * 100;
+    running = true;
+
+    sched_add(&morph_timer, morph_update, 0, MORPH_STEP_TIME);
+
+    return true;
+}
+
+void morph_stop() {
+    running = false;
+    sched_cancel(&morph_timer);
+}
+
+bool morph_running() {
+    return running;
+}
+
+// Queues the next intermediate values for every channel whose
+// previous ones have already been applied
+void morph_update() {
+    uint32_t elapsed = millis() - start_time;
+
+    if (elapsed >= duration_ms) {
+        morph_stop();
+        load_slot(target);
+
+        if (get_current_menu() == LIST_MENU) reload_screen();
+
+        return;
+    }
+
+    // 8-bit fixed point fraction, so every channel is interpolated
+    // with a multiplication instead of a division
+    uint16_t frac = (elapsed << 8) / duration_ms;
+
+    for (int i = 0; i < NUM_PINS; i++) {
+        if (!channels[i].active || active_pins[i].pending) continue;
+
+        queue_pin_config(active_pins, i,
+                         lerp(channels[i].frq, frac),
+                         lerp(channels[i].dty, frac),
+                         lerp(channels[i].phs, frac));
+    }
+}
+
+int16_t lerp(int16_t *values, uint16_t frac) {
+    return values[0] + (int16_t)(((int32_t)(values[1] - values[0]) * frac) >> 8);
+}
+
+uint16_t effective_dty(uint8_t mode, uint16_t dty) {
+    switch (mode) {
+        case OFF_MODE: return 0;
+        case ON_MODE: return 100;
+        default: return dty;
+    }
+}
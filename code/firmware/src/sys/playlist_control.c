@@ -0,0 +1,80 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ * 
+ * @brief Steps through stored playlists of slots
+ */
+
+#include "sys/playlist_control.h"
+
+#include "common/config.h"
+#include "sys/eeprom_control.h"
+#include "sys/menu_control.h"
+#include "sys/menu/list_menu.h"
+#include "sys/morph_control.h"
+#include "sys/scheduler.h"
+
+static playlist_t playlist;
+static int8_t running = -1;
+static uint8_t step = 0;
+static sched_timer_t step_timer;
+
+
+/* Local declarations */
+
+void next_step();
+void load_step();
+
+
+/* Definitions */
+
+bool playlist_start(uint8_t idx) {
+    if (idx >= NUM_PLAYLISTS || eeprom_get_playlist_steps(idx) == 0) return false;
+
+    eeprom_get_playlist(idx, &playlist);
+
+    running = idx;
+    step = 0;
+
+    sched_add(&step_timer, next_step, (uint32_t)playlist.steps[0].dwell * 100, 0);
+    load_step();
+
+    return true;
+}
+
+void playlist_stop() {
+    if (running != -1) morph_stop();
+    running = -1;
+
+    sched_cancel(&step_timer);
+}
+
+int8_t playlist_running() {
+    return running;
+}
+
+uint8_t playlist_step() {
+    return step;
+}
+
+void next_step() {
+    step = (step + 1) % playlist.num_steps;
+
+    // Counted from the previous deadline, so the schedule doesn't drift
+    sched_restart(&step_timer, (uint32_t)playlist.steps[step].dwell * 100);
+    load_step();
+}
+
+void load_step() {
+    // Slots may have been deleted since the playlist was stored
+    if (playlist.steps[step].slot < eeprom_get_used_slots()) {
+        if (playlist.steps[step].fade != 0) {
+            morph_start(playlist.steps[step].slot, playlist.steps[step].fade);
+        }
+        else {
+            load_slot(playlist.steps[step].slot);
+
+            if (get_current_menu() == LIST_MENU) reload_screen();
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/**
+ * @author Jose Manuel García Cazorla <jmgarcaz@correo.ugr.es>
+ * @copyright (C) GranaSAT, GNU General Public License Version 3
+ * 
+ * @brief Cooperative timer wheel for housekeeping tasks
+ */
+
+#include "sys/scheduler.h"
+
+#define SCHED_MASK (SCHED_WHEEL_SIZE - 1)
+
+static sched_timer_t *wheel[SCHED_WHEEL_SIZE];
+static sched_timer_t *expired = NULL;  // Timers taken out of the wheel, waiting to run
+static uint32_t tick = 0;  // Next tick to process
+
+
+/* Local declarations */
+
+void insert(sched_timer_t *timer);
+bool unlink(sched_timer_t **list, sched_timer_t *timer);
+
+
+/* Definitions */
+
+void sched_setup() {
+    tick = millis();
+}
+
+void sched_add(sched_timer_t *timer, sched_callback_t callback, uint32_t delay, uint32_t period) {
+    sched_cancel(timer);
+
+    timer->callback = callback;
+    timer->period = period;
+
+    timer->deadline = millis() + delay;
+
+    insert(timer);
+}
+
+void sched_restart(sched_timer_t *timer, uint32_t delay) {
+    uint32_t deadline = timer->deadline + delay;
+
+    sched_cancel(timer);
+
+    timer->deadline = deadline;
+
+    insert(timer);
+}
+
+void sched_cancel(sched_timer_t *timer) {
+    if (!timer->active) return;
+
+    if (!unlink(&wheel[timer->deadline & SCHED_MASK], timer)) {
+        unlink(&expired, timer);
+    }
+
+    timer->active = false;
+}
+
+bool sched_active(sched_timer_t *timer) {
+    return timer->active;
+}
+
+void sched_update() {
+    uint32_t now = millis();
+
+    while ((int32_t)(now - tick) >= 0) {
+        sched_timer_t **bucket = &wheel[tick & SCHED_MASK];
+
+        // Move the timers due on this tick out of the wheel, keeping
+        // the ones due on later turns
+        while (*bucket != NULL) {
+            sched_timer_t *timer = *bucket;
+
+            if (timer->deadline == tick) {
+                *bucket = timer->next;
+                timer->next = expired;
+                expired = timer;
+            }
+            else {
+                bucket = &timer->next;
+            }
+        }
+
+        // From now on, anything due is run on the next tick
+        tick++;
+
+        // Callbacks may add or cancel any timer, this one included
+        while (expired != NULL) {
+            sched_timer_t *timer = expired;
+            expired = timer->next;
+
+            timer->active = false;
+
+            if (timer->period != 0) {
+                timer->deadline += timer->period;
+                insert(timer);
+            }
+
+            timer->callback();
+        }
+    }
+}
+
+void insert(sched_timer_t *timer) {
+    // Ticks already processed won't be looked at again until the
+    // wheel wraps, so late timers are moved to the next one
+    if ((int32_t)(timer->deadline - tick) < 0) timer->deadline = tick;
+
+    sched_timer_t **bucket = &wheel[timer->deadline & SCHED_MASK];
+
+    timer->next = *bucket;
+    *bucket = timer;
+    timer->active = true;
+}
+
+bool unlink(sched_timer_t **list, sched_timer_t *timer) {
+    while (*list != NULL) {
+        if (*list == timer) {
+            *list = timer->next;
+            return true;
+        }
+
+        list = &(*list)->next;
+    }
+
+    return false;
+}
@@ -3,13 +3,149 @@
 #
 #  @author Jose Manuel Garcia Cazorla <jmgarcaz@correo.ugr.es>
 
+import binascii
 import re
+import struct
 import time
 
 from serial import Serial
 from serial.tools.list_ports import comports
 
 
+## Baud rate the device starts at, SER_BAUD in the firmware's config.h
+DEFAULT_BAUD = 115200
+
+## Seconds the device waits for the probe after a baud rate change, SER_PROBE_TIME
+BAUD_PROBE_TIME = 1.0
+
+## Binary protocol frame types, see frame_control.h in the firmware
+FR_PING = 0x01
+FR_GET_INFO = 0x02
+FR_GET_SLOTS = 0x03
+FR_SLOT_COUNT = 0x04
+FR_SLOT = 0x05
+FR_PWM = 0x06
+FR_GET_HASHES = 0x07
+FR_GET_SLOT = 0x08
+FR_SYNC_COUNT = 0x09
+FR_LIVE = 0x0A
+FR_TELEMETRY = 0x0B
+FR_GET_LINK = 0x0C
+FR_GET_IMAGE = 0x0D
+FR_IMAGE_SIZE = 0x0E
+FR_ASCII = 0x0F
+FR_IMAGE_DATA = 0x10
+FR_IMAGE_CRC = 0x11
+FR_ACTIVATE = 0x12
+FR_GET_STATUS = 0x13
+FR_PONG = 0x81
+FR_INFO = 0x82
+FR_HASHES = 0x87
+FR_LIVE_DONE = 0x8A
+FR_STATUS = 0x8B
+FR_LINK = 0x8C
+FR_REPLY = 0x80
+FR_ACK = 0xFE
+FR_NAK = 0xFF
+
+## Reasons for a FR_NAK
+NAK_CRC = 1
+NAK_FORMAT = 2
+NAK_TYPE = 3
+NAK_BUSY = 4
+NAK_SEQ = 5
+
+## Tagged requests kept in flight, fewer than SER_RX_LINES in the firmware's config.h
+TAG_WINDOW = 3
+
+## Seconds a tagged request waits for its reply
+TAG_TIMEOUT = 1.0
+
+## Binary protocol version this module speaks
+BIN_VERSION = 1
+
+## Upload frames kept in flight, up to BIN_WINDOW in the firmware's config.h
+BIN_WINDOW = 4
+
+## Seconds without an ACK before the window is sent again
+BIN_ACK_TIMEOUT = 0.3
+
+## Times the window is sent again before giving up
+BIN_RETRIES = 10
+
+## Image bytes per FR_IMAGE_DATA frame, besides the offset
+IMAGE_CHUNK = 57
+
+## Seconds to wait for the device to finish pending EEPROM writes before a restore
+IMAGE_BUSY_TIMEOUT = 15.0
+
+## Layout of the firmware's pwm_t: name, mode, frequency (tenths of Hz), duty cycle, phase
+PWM_STRUCT = struct.Struct("<20sBHHh")
+
+## Layout of the firmware's status_t, see telemetry_control.h
+STATUS_STRUCT = struct.Struct("<IbbBbHBBH" + "HBb" * 8 + "BBHH")
+
+## Length of the firmware's slot names, including the terminator
+## Link quality counters, in the order the device sends them
+LINK_NAMES = ["framing", "overrun", "parity", "dropped", "truncated",
+              "err1", "err2", "err3", "err4", "err5", "crc"]
+
+SLOT_NAME_SIZE = 12
+
+## Length of the firmware's PWM names, including the terminator
+PWM_NAME_SIZE = 20
+
+
+## Removes every zero from a block of data (Consistent Overhead Byte Stuffing)
+#  @param data Up to 254 bytes
+#  @return bytes Encoded data, one byte longer, without the trailing zero
+def cobs_encode(data: bytes) -> bytes:
+    out = bytearray()
+
+    for block in data.split(b"\x00"):
+        out.append(len(block) + 1)
+        out += block
+
+    return bytes(out)
+
+
+## Undoes @ref cobs_encode
+#  @param data Encoded data, without the trailing zero
+#  @return bytes Decoded data, None if it isn't valid COBS
+def cobs_decode(data: bytes) -> bytes | None:
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        code = data[i]
+
+        if code == 0 or i + code > len(data):
+            return None
+
+        out += data[i + 1:i + code]
+        i += code
+
+        if code < 0xFF and i < len(data):
+            out.append(0)
+
+    return bytes(out)
+
+
+## Computes a slot's hash the same way as the firmware's eeprom_get_slot_crc()
+#  @param slot Slot to hash
+#  @return int CRC-16/CCITT of the names (up to their terminator) and values
+def slot_hash(slot) -> int:
+    crc = binascii.crc_hqx(slot.name.encode()[:SLOT_NAME_SIZE - 1] + b"\x00", 0xFFFF)
+
+    for pwm in slot.pwms:
+        crc = binascii.crc_hqx(pwm.name.encode()[:PWM_NAME_SIZE - 1] + b"\x00", crc)
+        crc = binascii.crc_hqx(struct.pack(
+            "<BHHh", int(pwm.mode), round(pwm.frq * 10), int(pwm.dty), int(pwm.phs)
+        ), crc)
+
+    return crc
+
+
 ## Defines the representation of a PWM
 class PWM:
     ## Constructor
@@ -106,6 +242,33 @@ class Slot:
         return pwms
 
 
+## Defines the representation of a playlist
+class Playlist:
+    ## Constructor
+    #  @param self Object pointer
+    #  @param name Name of the playlist
+    #  @param steps List of (slot index, dwell time, fade time) tuples, times in seconds
+    def __init__(self, name: str = "", steps: list[tuple[int, float, float]] = []) -> None:
+        self.name = name
+        self.steps = steps
+
+    ## Print format
+    #  @param self Object pointer
+    #  @return str To be printed
+    def __str__(self) -> str:
+        string = "Playlist: " + self.name + "\n"
+
+        for slot, dwell, fade in self.steps:
+            string += "Slot " + str(slot) + " for " + str(dwell) + " s"
+
+            if fade != 0:
+                string += " (" + str(fade) + " s fade)"
+
+            string += "\n"
+
+        return string
+
+
 ## Defines the representation of the PWM Box, providing methods to interact with it
 class PWMBox:
     ## Constructor
@@ -125,12 +288,17 @@ class PWMBox:
         self.max_slots: int = None
 
         self.slots: list[Slot] = []
+        self.playlists: list[Playlist] = []
+
+        self.binary = False
+        self.seq = 0
 
         # Find the device
         self.connect()
 
         # If we find it, get its info
         if self.serial is not None:
+            self.use_fastest_baud()
             self.get_info()
             self.get_password()
             self.get_slots()
@@ -143,13 +311,21 @@ class PWMBox:
         for i in comports():
             # Use the device description to narrow our search
             if re.search("usb.serial", i.description, re.IGNORECASE):
-                candidate = Serial(port=i.device, baudrate=115200, timeout=1)
+                candidate = Serial(port=i.device, baudrate=DEFAULT_BAUD, timeout=1)
 
 
                 time.sleep(2)  # Give the device time to wake up
 
                 candidate.write(("^?,@\n").encode())  # Initial handshake
-                response = candidate.read_until().decode()
+                response = candidate.read_until().decode(errors="ignore")
+
+                # Device may have been left at a faster rate. Our garbage makes it
+                # fall back, try again once it has
+                if "^!,@" not in response:
+                    time.sleep(2 * BAUD_PROBE_TIME)
+                    candidate.reset_input_buffer()
+                    candidate.write(("^?,@\n").encode())
+                    response = candidate.read_until().decode(errors="ignore")
 
                 if "^!,@" in response:
                     self.serial = candidate
@@ -202,11 +378,20 @@ class PWMBox:
             self.password = [int(m.group(1)), int(m.group(2)), int(m.group(3))]
 
     ## Gets the device's slots
+    #  Uses the binary protocol when the device supports it, so only the slots
+    #  that changed are read
     #  @param self Object pointer
     def get_slots(self) -> None:
         if self.serial is None:
             return
-        
+
+        if self.enter_binary():
+            received = self.get_slots_binary()
+            self.leave_binary()
+
+            if received:
+                return
+
         # If slots are already loaded, delete them
         if self.slots:
             self.slots.clear()
@@ -268,12 +453,68 @@ class PWMBox:
         self.default_slot = new
         self.serial.write(("^!,d," + str(self.default_slot) + "\n").encode())
 
+    ## Opens a batch on the device
+    #  Channel, default slot and brightness changes sent until the commit
+    #  are only recorded, and applied together on commit. Anything else is
+    #  rejected while the batch is open
+    #  @param self Object pointer
+    def begin_batch(self) -> None:
+        self.serial.write("^!,x,b\n".encode())
+
+    ## Applies the open batch
+    #  Every channel changes at the same interrupt cycle, and the settings
+    #  are written to the EEPROM in a single pass
+    #  @param self Object pointer
+    #  @return Number of changes applied, 0 if the batch had been discarded
+    def commit_batch(self) -> int:
+        self.serial.write("^!,x,c\n".encode())
+        response = self.serial.read_until().decode(errors="ignore")
+
+        m = re.match(r"\^!,x,(\d+)", response)
+
+        return int(m.group(1)) if m is not None else 0
+
+    ## Discards the open batch
+    #  @param self Object pointer
+    def abort_batch(self) -> None:
+        self.serial.write("^!,x,a\n".encode())
+
+    ## Records an output change in the open batch
+    #  @param self Object pointer
+    #  @param pin Index of the output
+    #  @param mode 0 = OFF, 1 = PWM, 2 = ON
+    #  @param frq Frequency of the signal (0 - 400 Hz)
+    #  @param dty Duty cycle of the signal (0 - 100%)
+    #  @param phs Phase of the signal (-50 - 50%)
+    def set_channel(self, pin: int, mode: int, frq: float, dty: int, phs: int) -> None:
+        self.serial.write((
+            "^!,v," +
+            str(pin) + "," +
+            str(mode) + "," +
+            str(round(frq * 10)) + "," +
+            str(int(dty)) + "," +
+            str(int(phs)) + "\n"
+        ).encode())
+
+    ## Sets the screen brightness, recorded if a batch is open
+    #  @param self Object pointer
+    #  @param value Brightness, from 0 to 100
+    def set_brightness(self, value: int) -> None:
+        self.serial.write(("^!,g," + str(value) + "\n").encode())
+
     ## Send slots to the device
+    #  Uses the acknowledged binary upload when the device supports it. Otherwise
+    #  lines are sent back to back, the device buffers them while parsing
     #  @param self Object pointer
-    def set_slots(self) -> None:
-        self.serial.write(("^!,n," + str(len(self.slots)) + "\n").encode())
+    #  @return True if the device has queued every line
+    def set_slots(self) -> bool:
+        if self.enter_binary():
+            accepted = self.set_slots_binary()
+            self.leave_binary()
+
+            return accepted
 
-        time.sleep(0.5)  # Device needs time to process data
+        self.serial.write(("^!,n," + str(len(self.slots)) + "\n").encode())
 
         for i in range(len(self.slots)):
             self.serial.write((
@@ -282,8 +523,6 @@ class PWMBox:
                 self.slots[i].name + "\n"
             ).encode())
 
-            time.sleep(0.5)  # Device needs time to process data
-
             for j in range(self.NUM_PWMS):
                 self.serial.write((
                     "^!,p," +
@@ -295,5 +534,747 @@ class PWMBox:
                     str(int(self.slots[i].pwms[j].phs)) + "\n"
                 ).encode())
 
-                time.sleep(0.5)  # Device needs time to process data
+        return self.commands_accepted()
+
+
+    ## Gets the device's playlists
+    #  Unused playlists are returned with no steps
+    #  @param self Object pointer
+    def get_playlists(self) -> None:
+        if self.serial is None:
+            return
+
+        self.playlists.clear()
+
+        self.serial.write("^?,l\n".encode())  # Playlists
+        response = self.serial.read_until().decode()
+
+        num_playlists = int(re.match(r"\^!,l,(.*)", response).group(1))
+
+        for i in range(num_playlists):
+            response = self.serial.read_until().decode()
+
+            m = re.match(r"\^!,l,(.*),(.*),(.*)", response)
+            name = str(m.group(2))
+            num_steps = int(m.group(3))
+
+            steps: list[tuple[int, float, float]] = []
+
+            for j in range(num_steps):
+                response = self.serial.read_until().decode()
+
+                m = re.match(r"\^!,t,(.*),(.*),(.*),(.*)", response)
+                steps.append((int(m.group(2)), int(m.group(3)) / 10, int(m.group(4)) / 10))
+
+            self.playlists.append(Playlist(name, steps))
+
+    ## Stores a playlist in the device
+    #  @param self Object pointer
+    #  @param idx Index of the playlist
+    #  @param playlist Playlist to be sent, an empty one deletes it
+    #  @return True if the device has queued every line
+    def set_playlist(self, idx: int, playlist: Playlist) -> bool:
+        self.serial.write((
+            "^!,l," +
+            str(idx) + "," +
+            playlist.name + "," +
+            str(len(playlist.steps)) + "\n"
+        ).encode())
+
+        for i in range(len(playlist.steps)):
+            slot, dwell, fade = playlist.steps[i]
+
+            self.serial.write((
+                "^!,t," +
+                str(i) + "," +
+                str(slot) + "," +
+                str(int(dwell * 10)) + "," +
+                str(int(fade * 10)) + "\n"
+            ).encode())
+
+        return self.commands_accepted()
+
+    ## Checks whether the device has dropped any of the lines just sent
+    #  The device replies ^!,BUSY,C to every line it couldn't buffer, C
+    #  being the dropped command, and ^!,ERRX to every line it couldn't parse
+    #  @param self Object pointer
+    #  @return True if every line was buffered and accepted
+    def commands_accepted(self) -> bool:
+        self.serial.flush()
+        time.sleep(0.1)  # Give the last replies time to arrive
+
+        pending = self.serial.read(self.serial.in_waiting).decode(errors="ignore")
+
+        return "^!,BUSY" not in pending and "^!,ERR" not in pending
+
+    ## Sends several requests back to back and matches the replies by tag
+    #  Each request is sent as ^#T,... and its reply comes back as ^#T,!,...
+    #  Tagged requests are run even while a long reply is being sent, so
+    #  replies may arrive in any order. Set commands without a reply of their
+    #  own are confirmed with ^!,OK. Only the first line of every reply is kept
+    #  @param self Object pointer
+    #  @param requests Requests without the leading ^ (e.g. "?,i", "!,d,2")
+    #  @return Reply to every request, in order and without the tag. None if it never came
+    def pipeline(self, requests: list[str]) -> list[str | None]:
+        replies = [None] * len(requests)
+        sent = 0
+        waiting = {}  # Tag -> index and time it was sent
+
+        timeout = self.serial.timeout
+        self.serial.timeout = TAG_TIMEOUT
+
+        while sent < len(requests) or waiting:
+            while sent < len(requests) and len(waiting) < TAG_WINDOW:
+                tag = str(sent % 10000)
+                self.serial.write(("^#" + tag + "," + requests[sent] + "\n").encode())
+                waiting[tag] = (sent, time.monotonic())
+                sent += 1
+
+            line = self.serial.read_until().decode(errors="ignore").strip()
+            m = re.match(r"\^#(\w+),(.*)", line)
+
+            if m is not None and m.group(1) in waiting:
+                replies[waiting.pop(m.group(1))[0]] = "^" + m.group(2)
+
+            # Dropped requests and lost replies are given up on
+            now = time.monotonic()
+            for tag in [t for t, (_, start) in waiting.items() if now - start > TAG_TIMEOUT]:
+                del waiting[tag]
+
+        self.serial.timeout = timeout
+        return replies
+
+    ## Fades the outputs into a stored slot
+    #  @param self Object pointer
+    #  @param slot Index of the target slot
+    #  @param duration Transition time in seconds
+    def morph(self, slot: int, duration: float) -> None:
+        self.serial.write(("^!,m," + str(slot) + "," + str(int(duration * 10)) + "\n").encode())
+
+    ## Gets the device's event queue statistics
+    #  @param self Object pointer
+    #  @return Dictionary with the current depth, high-water mark, size, dropped events per source, highest latency and longest loop pass in microseconds
+    def get_event_stats(self) -> dict:
+        if self.serial is None:
+            return {}
+
+        self.serial.write("^?,e\n".encode())  # Event queue
+        response = self.serial.read_until().decode()
+
+        m = re.match(r"\^!,e,(\d+),(\d+),(\d+),(\d+),(\d+),(\d+),(\d+),(\d+),(\d+),(\d+)", response)
+
+        if m is None:  # Device replied ^!,BUSY or garbage
+            return {}
+
+        values = [int(v) for v in m.groups()]
+
+        return {
+            "depth": values[0],
+            "max_depth": values[1],
+            "size": values[2],
+            "dropped": {
+                "rotary": values[3] + values[4],
+                "button": values[5] + values[6],
+                "serial": values[7]
+            },
+            "max_latency": values[8],
+            "max_stall": values[9]
+        }
+
+    ## Gets the device's latency histograms
+    #  @param self Object pointer
+    #  @return Dictionary with the tick length in microseconds and the bin counts of every histogram. Bin 0 counts 0 ticks, bin i from 2^(i - 1) to 2^i - 1 ticks
+    def get_latency_histograms(self) -> dict:
+        if self.serial is None:
+            return {}
+
+        self.serial.write("^?,h\n".encode())  # Histograms
+        response = self.serial.read_until().decode()
+
+        m = re.match(r"\^!,h,(\d+),(\d+),(\d+)", response)
+
+        if m is None:  # Device replied ^!,BUSY or garbage
+            return {}
+
+        names = ["rotary_left", "rotary_right", "button_push", "button_hold", "serial", "serial_effect", "format"]
+        histograms = {}
+
+        for _ in range(int(m.group(1))):
+            fields = self.serial.read_until().decode().strip().split(",")
+            idx = int(fields[2])
+
+            histograms[names[idx] if idx < len(names) else str(idx)] = [int(c) for c in fields[3:]]
+
+        return {"tick_us": int(m.group(3)), "histograms": histograms}
+
+    ## Empties the device's latency histograms
+    #  @param self Object pointer
+    def clear_latency_histograms(self) -> None:
+        self.serial.write("^!,h\n".encode())
+
+    ## Gets the device's link quality counters
+    #  Works in both protocols
+    #  @param self Object pointer
+    #  @param clear Whether to clear them once read (binary mode only)
+    #  @return Dictionary with the bytes received with framing, overrun and parity errors, the lines dropped and truncated, the lines replied with each ERR code and the frames with a wrong CRC. Empty on error
+    def get_link_stats(self, clear: bool = False) -> dict:
+        if self.serial is None:
+            return {}
+
+        if self.binary:
+            reply = self.request(FR_GET_LINK, bytes([1]) if clear else b"")
+
+            if reply is None or reply[0] != FR_LINK:
+                return {}
+
+            values = struct.unpack("<" + str(len(reply[1]) // 2) + "H", reply[1])
+        else:
+            self.serial.write("^?,q\n".encode())  # Link counters
+            response = self.serial.read_until().decode()
+
+            if not response.startswith("^!,q,"):  # Device replied ^!,BUSY or garbage
+                return {}
+
+            values = [int(v) for v in response.strip().split(",")[2:]]
+
+        return {LINK_NAMES[i] if i < len(LINK_NAMES) else str(i): v for i, v in enumerate(values)}
+
+    ## Clears the device's link quality counters
+    #  @param self Object pointer
+    def clear_link_stats(self) -> None:
+        if self.binary:
+            self.get_link_stats(clear=True)
+        else:
+            self.serial.write("^!,q\n".encode())
+
+    ## Switches the device to the binary protocol
+    #  The device goes back to ASCII by itself after 10 s without frames
+    #  @param self Object pointer
+    #  @return True if the device speaks the same protocol version
+    def enter_binary(self) -> bool:
+        if self.serial is None:
+            return False
+
+        self.serial.write("^?,b\n".encode())
+        response = self.serial.read_until().decode(errors="ignore")
+
+        m = re.match(r"\^!,b,(\d+)", response)
+
+        if m is None:  # Older firmware replies ^!,ERR2
+            return False
+
+        self.binary = True
+        self.serial.timeout = BIN_ACK_TIMEOUT
+
+        if int(m.group(1)) != BIN_VERSION:
+            self.leave_binary()
+            return False
+
+        return True
+
+    ## Switches the device back to the ASCII protocol
+    #  @param self Object pointer
+    def leave_binary(self) -> None:
+        self.request(FR_ASCII)
+        self.binary = False
+        self.serial.timeout = None
+
+    ## Sends a frame
+    #  @param self Object pointer
+    #  @param type Frame type
+    #  @param payload Frame payload
+    #  @param seq Sequence number, the next one if None
+    #  @return int Sequence number of the frame
+    def send_frame(self, type: int, payload: bytes = b"", seq: int | None = None) -> int:
+        if seq is None:
+            seq = self.seq
+            self.seq = (self.seq + 1) & 0xFF
+
+        frame = bytes([type, seq]) + payload
+        frame += struct.pack("<H", binascii.crc_hqx(frame, 0xFFFF))
+
+        self.serial.write(cobs_encode(frame) + b"\x00")
+
+        return seq
+
+    ## Receives a frame, skipping corrupted ones
+    #  @param self Object pointer
+    #  @return Tuple with the type, sequence number and payload, None on timeout
+    def read_frame(self) -> tuple[int, int, bytes] | None:
+        while True:
+            raw = self.serial.read_until(b"\x00")
+
+            if not raw.endswith(b"\x00"):  # Timeout
+                return None
+
+            frame = cobs_decode(raw[:-1])
+
+            if frame is None or len(frame) < 4:
+                continue
+
+            if binascii.crc_hqx(frame[:-2], 0xFFFF) != struct.unpack("<H", frame[-2:])[0]:
+                continue
+
+            return frame[0], frame[1], frame[2:-2]
+
+    ## Sends a frame and waits for its reply
+    #  @param self Object pointer
+    #  @param type Frame type
+    #  @param payload Frame payload
+    #  @return Tuple with the reply type and payload, None on timeout
+    def request(self, type: int, payload: bytes = b"") -> tuple[int, bytes] | None:
+        seq = self.send_frame(type, payload)
+
+        while True:
+            reply = self.read_frame()
+
+            if reply is None:
+                return None
+
+            if reply[1] == seq:
+                return reply[0], reply[2]
+
+    ## Checks the binary link
+    #  @param self Object pointer
+    #  @return True if the device answered
+    def ping(self) -> bool:
+        reply = self.request(FR_PING)
+
+        return reply is not None and reply[0] == FR_PONG
+
+    ## Gets the hash of every slot in the device
+    #  @param self Object pointer
+    #  @return List of hashes, as computed by @ref slot_hash. None on error
+    def get_slot_hashes(self) -> list[int] | None:
+        reply = self.request(FR_GET_HASHES)
+
+        if reply is None or reply[0] != FR_HASHES:
+            return None
+
+        return list(struct.unpack("<" + str(reply[1][0]) + "H", reply[1][1:]))
+
+    ## Receives the frames of a slot, after FR_GET_SLOTS or FR_GET_SLOT
+    #  @param self Object pointer
+    #  @param seq Sequence number of the request
+    #  @return The slot, None on error
+    def read_slot_frames(self, seq: int) -> Slot | None:
+        slot = None
+
+        while slot is None or len(slot.pwms) < self.NUM_PWMS:
+            reply = self.read_frame()
+
+            if reply is None or (reply[0] == FR_NAK and reply[1] == seq):
+                return None
+
+            type, reply_seq, payload = reply
+
+            if reply_seq != seq:
+                continue
+
+            if type == FR_SLOT | FR_REPLY:
+                name = payload[1:].split(b"\x00")[0].decode(errors="ignore")
+                slot = Slot(name, [])
+            elif type == FR_PWM | FR_REPLY and slot is not None:
+                name, mode, frq, dty, phs = PWM_STRUCT.unpack(payload[2:])
+                name = name.split(b"\x00")[0].decode(errors="ignore")
+                slot.pwms.append(PWM(name, mode, frq / 10, dty, phs))
+
+        return slot
+
+    ## Gets the device's slots through the binary protocol
+    #  Only the slots whose hash differs from the local copy are read
+    #  @param self Object pointer
+    #  @return True if every slot arrived
+    def get_slots_binary(self) -> bool:
+        hashes = self.get_slot_hashes()
+
+        if hashes is None:
+            return False
+
+        slots = self.slots[:len(hashes)]
+
+        for i in range(len(hashes)):
+            if i < len(slots) and slot_hash(slots[i]) == hashes[i]:
+                continue
+
+            slot = self.read_slot_frames(self.send_frame(FR_GET_SLOT, bytes([i])))
+
+            if slot is None:
+                return False
+
+            if i < len(slots):
+                slots[i] = slot
+            else:
+                slots.append(slot)
+
+        self.slots = slots
+
+        return True
+
+    ## Sends slots to the device through the binary protocol
+    #  Only the slots whose hash differs from the device's are sent, the rest
+    #  aren't even rewritten
+    #  @param self Object pointer
+    #  @return True if the device has applied every frame
+    def set_slots_binary(self) -> bool:
+        hashes = self.get_slot_hashes()
+
+        if hashes is None:
+            return False
+
+        frames = [(FR_SYNC_COUNT, bytes([len(self.slots)]))]
+
+        for i in range(len(self.slots)):
+            if i < len(hashes) and slot_hash(self.slots[i]) == hashes[i]:
+                continue
+
+            name = self.slots[i].name.encode()[:SLOT_NAME_SIZE - 1]
+            frames.append((FR_SLOT, bytes([i]) + name))
+
+            for j in range(self.NUM_PWMS):
+                pwm = self.slots[i].pwms[j]
+                frames.append((FR_PWM, bytes([i, j]) + PWM_STRUCT.pack(
+                    pwm.name.encode()[:PWM_NAME_SIZE - 1], int(pwm.mode),
+                    round(pwm.frq * 10), int(pwm.dty), int(pwm.phs)
+                )))
+
+        return self.send_window(frames)
+
+    ## Reads the device's whole EEPROM image
+    #  Must be in binary mode, see @ref enter_binary. Meant to be written to
+    #  another device of the same firmware version with @ref set_image
+    #  @param self Object pointer
+    #  @return The image, None on error or if it didn't match its CRC
+    def get_image(self) -> bytes | None:
+        seq = self.send_frame(FR_GET_IMAGE)
+        image = b""
+        size = None
+
+        while True:
+            reply = self.read_frame()
+
+            if reply is None:
+                return None
+
+            type, reply_seq, payload = reply
+
+            if reply_seq != seq:
+                continue
+
+            if type == FR_IMAGE_SIZE | FR_REPLY:
+                size = struct.unpack("<H", payload)[0]
+            elif type == FR_IMAGE_DATA | FR_REPLY:
+                if struct.unpack("<H", payload[:2])[0] != len(image):
+                    return None  # A chunk got lost
+
+                image += payload[2:]
+            elif type == FR_IMAGE_CRC | FR_REPLY:
+                if len(image) != size or struct.unpack("<H", payload)[0] != binascii.crc_hqx(image, 0xFFFF):
+                    return None
+
+                return image
+            elif type == FR_NAK:
+                return None
+
+    ## Writes a whole EEPROM image to the device
+    #  Must be in binary mode, see @ref enter_binary. The device only applies it
+    #  if it arrives whole and matches its CRC, and then only writes the bytes
+    #  that changed. It keeps its own serial number, and loads the image's
+    #  default slot
+    #  @param self Object pointer
+    #  @param image Image read with @ref get_image
+    #  @return True if the device has applied the image
+    def set_image(self, image: bytes) -> bool:
+        deadline = time.time() + IMAGE_BUSY_TIMEOUT
+
+        # Refused while the device is still writing previous changes
+        while True:
+            reply = self.request(FR_IMAGE_SIZE, struct.pack("<H", len(image)))
+
+            if reply is not None and reply[0] == FR_ACK:
+                break
+
+            if reply is None or reply[0] != FR_NAK or reply[1][0] != NAK_BUSY or time.time() > deadline:
+                return False
+
+            time.sleep(0.1)
+
+        frames = []
+
+        for offset in range(0, len(image), IMAGE_CHUNK):
+            frames.append((FR_IMAGE_DATA, struct.pack("<H", offset) + image[offset:offset + IMAGE_CHUNK]))
+
+        frames.append((FR_IMAGE_CRC, struct.pack("<H", binascii.crc_hqx(image, 0xFFFF))))
+
+        if not self.send_window(frames):
+            return False
+
+        # Local copy of the library
+        self.get_slots_binary()
+
+        return True
+
+    ## Sends frames in a sliding window, retransmitting on errors
+    #  @param self Object pointer
+    #  @param frames List of frame types and payloads, fewer than 256
+    #  @return True if the device has acknowledged every frame
+    def send_window(self, frames: list[tuple[int, bytes]]) -> bool:
+        first = self.seq
+        self.seq = (self.seq + len(frames)) & 0xFF
+
+        base = 0  # Oldest frame not acknowledged
+        next = 0  # Next frame to send
+        retries = 0
+
+        while base < len(frames):
+            while next < len(frames) and next < base + BIN_WINDOW:
+                self.send_frame(frames[next][0], frames[next][1], (first + next) & 0xFF)
+                next += 1
+
+            reply = self.read_frame()
+
+            if reply is not None:
+                type, seq, payload = reply
+                idx = (seq - first) & 0xFF  # Frame the reply refers to
+
+                if type == FR_ACK and base <= idx < next:
+                    base = idx + 1
+                    retries = 0
+                    continue
+
+                if type != FR_NAK:
+                    continue
+
+                if payload[0] in (NAK_FORMAT, NAK_TYPE):
+                    return False  # Sending it again won't help
+
+            retries += 1
+
+            if retries > BIN_RETRIES:
+                return False
+
+            # Let frames still in flight get rejected, and go back
+            time.sleep(0.02)
+            self.serial.reset_input_buffer()
+            next = base
+
+        return True
+
+    ## Changes a running output, without touching the stored slots
+    #  Must be in binary mode, see @ref enter_binary. PWM changes take effect when
+    #  the output's current period is over. Only one change per output can be
+    #  waiting, send the next one after the previous is confirmed
+    #  @param self Object pointer
+    #  @param pin Index of the output
+    #  @param mode 0 = OFF, 1 = PWM, 2 = ON
+    #  @param frq Frequency of the signal (0 - 400 Hz)
+    #  @param dty Duty cycle of the signal (0 - 100%)
+    #  @param phs Phase of the signal (-50 - 50%)
+    #  @return int Sequence number of the change, to match its confirmation
+    def set_live(self, pin: int, mode: int, frq: float, dty: int, phs: int) -> int:
+        return self.send_frame(FR_LIVE, struct.pack(
+            "<BBHHh", pin, mode, round(frq * 10), int(dty), int(phs)
+        ))
+
+    ## Waits for a live change to reach the output
+    #  @param self Object pointer
+    #  @param seq Sequence number returned by @ref set_live
+    #  @return int Interrupt cycle (about 50 us each) in which it took effect. None if it was rejected or timed out
+    def wait_live(self, seq: int) -> int | None:
+        while True:
+            reply = self.read_frame()
+
+            if reply is None:
+                return None
+
+            type, reply_seq, payload = reply
+
+            if reply_seq != seq:
+                continue
+
+            if type == FR_LIVE_DONE:
+                return struct.unpack("<I", payload[1:5])[0]
+
+            if type == FR_NAK:
+                return None
+
+    ## Makes the device send its live state periodically
+    #  Must be in binary mode, see @ref enter_binary. Status frames don't keep the
+    #  link alive, call @ref ping at least every 10 s
+    #  @param self Object pointer
+    #  @param period Time between status frames in seconds, 0 to stop them (at least 0.02 s)
+    def subscribe_telemetry(self, period: float) -> None:
+        self.send_frame(FR_TELEMETRY, struct.pack("<H", round(period * 1000)))
+
+    ## Waits for the next status frame
+    #  @param self Object pointer
+    #  @return Dictionary with the device's live state, None on timeout
+    def read_status(self) -> dict | None:
+        while True:
+            reply = self.read_frame()
+
+            if reply is None:
+                return None
+
+            if reply[0] == FR_STATUS and len(reply[2]) == STATUS_STRUCT.size:
+                return self.parse_status(reply[2])
+
+    ## Decodes the payload of a status frame
+    #  @param self Object pointer
+    #  @param payload Payload of a FR_STATUS frame
+    #  @return Dictionary with the device's live state
+    def parse_status(self, payload: bytes) -> dict:
+        values = STATUS_STRUCT.unpack(payload)
+        tick, slot, playlist, step, slow, slow_time, flags, states, modes = values[:9]
+        isr_load, depth, dropped, skipped = values[-4:]
+
+        pwms = []
+
+        for i in range(self.NUM_PWMS):
+            frq, dty, phs = values[9 + 3 * i:12 + 3 * i]
+            pwms.append({
+                "mode": (modes >> (2 * i)) & 3, "frq": frq / 10, "dty": dty,
+                "phs": phs, "state": (states >> i) & 1
+            })
+
+        return {
+            "tick": tick,
+            "active_slot": None if slot == -1 else slot,
+            "playlist": None if playlist == -1 else playlist,
+            "playlist_step": step,
+            "slow": None if slow == -1 else slow,
+            "slow_time": slow_time / 2,
+            "morphing": bool(flags & 1),
+            "pwms": pwms,
+            "isr_load": isr_load,
+            "queue_depth": depth,
+            "dropped": dropped,
+            "skipped": skipped
+        }
+
+    ## Gets which slot, playlist and slow sequence are active
+    #  Works in both protocols. In binary mode the whole status is returned, see
+    #  @ref read_status
+    #  @param self Object pointer
+    #  @return Dictionary with the device's live state, None on error
+    def get_live_state(self) -> dict | None:
+        if self.binary:
+            return self.status_request(FR_GET_STATUS)
+
+        self.serial.write("^?,a\n".encode())  # Live state
+
+        return self.read_active()
+
+    ## Puts a stored slot on the outputs, as the LOAD option of the list menu does
+    #  Any running playlist or slow sequence is stopped first. Works in both protocols
+    #  @param self Object pointer
+    #  @param idx Index of the slot, -1 to unload the active one
+    #  @return Dictionary with the resulting live state, None if the device refused it
+    def activate_slot(self, idx: int) -> dict | None:
+        if self.binary:
+            return self.status_request(FR_ACTIVATE, struct.pack("<Bb", 0, idx))
+
+        self.serial.write(("^!,a," + str(idx) + "\n").encode())
+
+        return self.read_active()
+
+    ## Starts a slow signal sequence, as the slow menu does
+    #  Every output is turned off first. Works in both protocols
+    #  @param self Object pointer
+    #  @param idx Index of the sequence, -1 to stop the running one
+    #  @return Dictionary with the resulting live state, None if the device refused it
+    def start_slow(self, idx: int) -> dict | None:
+        if self.binary:
+            return self.status_request(FR_ACTIVATE, struct.pack("<Bb", 1, idx))
+
+        self.serial.write(("^!,w," + str(idx) + "\n").encode())
+
+        return self.read_active()
+
+    ## Sends a request replied with a status frame
+    #  @param self Object pointer
+    #  @param type Frame type
+    #  @param payload Frame payload
+    #  @return Dictionary with the device's live state, None on error
+    def status_request(self, type: int, payload: bytes = b"") -> dict | None:
+        reply = self.request(type, payload)
+
+        if reply is None or reply[0] != FR_STATUS or len(reply[1]) != STATUS_STRUCT.size:
+            return None
+
+        return self.parse_status(reply[1])
+
+    ## Reads a ^!,a reply
+    #  @param self Object pointer
+    #  @return Dictionary with the device's live state, None on error
+    def read_active(self) -> dict | None:
+        response = self.serial.read_until().decode(errors="ignore")
+
+        m = re.match(r"\^!,a,(-?\d+),(-?\d+),(\d+),(-?\d+),(\d+),(\d+)", response)
+
+        if m is None:  # Device replied ^!,ERR4, ^!,BUSY or garbage
+            return None
+
+        slot, playlist, step, slow, slow_time, morphing = [int(v) for v in m.groups()]
+
+        return {
+            "active_slot": None if slot == -1 else slot,
+            "playlist": None if playlist == -1 else playlist,
+            "playlist_step": step,
+            "slow": None if slow == -1 else slow,
+            "slow_time": slow_time / 2,
+            "morphing": bool(morphing)
+        }
+
+    ## Gets the baud rates the device supports
+    #  @param self Object pointer
+    #  @return List of baud rates, the first one is the default
+    def get_bauds(self) -> list[int]:
+        self.serial.write("^?,r\n".encode())
+        response = self.serial.read_until().decode(errors="ignore")
+
+        if not response.startswith("^!,r,"):  # Older firmware replies ^!,ERR2
+            return [DEFAULT_BAUD]
+
+        return [int(b) for b in response.strip().split(",")[2:]]
+
+    ## Switches the link to another baud rate
+    #  The new rate is probed with a handshake. If it fails, both sides go back to
+    #  the default rate
+    #  @param self Object pointer
+    #  @param baud New baud rate, one of @ref get_bauds
+    #  @return True if the link works at the new rate
+    def set_baud(self, baud: int) -> bool:
+        self.serial.write(("^!,r," + str(baud) + "\n").encode())
+        response = self.serial.read_until().decode(errors="ignore")
+
+        if response.strip() != "^!,r," + str(baud):
+            return False
+
+        timeout = self.serial.timeout
+        self.serial.timeout = BAUD_PROBE_TIME / 2
+        self.serial.baudrate = baud
+
+        self.serial.reset_input_buffer()
+        self.serial.write("^?,@\n".encode())  # Probe
+        response = self.serial.read_until().decode(errors="ignore")
+
+        if "^!,@" not in response and baud != DEFAULT_BAUD:
+            # Device goes back on its own when the probe doesn't arrive
+            self.serial.baudrate = DEFAULT_BAUD
+            time.sleep(BAUD_PROBE_TIME)
+            self.serial.reset_input_buffer()
+
+        self.serial.timeout = timeout
+
+        return "^!,@" in response
+
+    ## Switches the link to the fastest baud rate that works
+    #  @param self Object pointer
+    #  @return int Baud rate in use
+    def use_fastest_baud(self) -> int:
+        for baud in sorted(self.get_bauds(), reverse=True):
+            if baud == DEFAULT_BAUD or self.set_baud(baud):
+                return baud
 
+        return DEFAULT_BAUD